@@ -0,0 +1,82 @@
+/*****************************************************************************
+  Licensed to Accellera Systems Initiative Inc. (Accellera) under one or
+  more contributor license agreements.  See the NOTICE file distributed
+  with this work for additional information regarding copyright ownership.
+  Accellera licenses this file to you under the Apache License, Version 2.0
+  (the "License"); you may not use this file except in compliance with the
+  License.  You may obtain a copy of the License at
+    http://www.apache.org/licenses/LICENSE-2.0
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+  implied.  See the License for the specific language governing
+  permissions and limitations under the License.
+ ****************************************************************************/
+
+#include <scp/report.h>
+
+#include <systemc>
+
+#include <atomic>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+
+/* checks that info messages do not allocate with directOutput(true) and
+ * logAsync(false). The default configuration allocates: sc_report_handler
+ * creates an sc_report for every message and the asynchronous logger copies
+ * the message into its queue. */
+
+/* count all heap allocations done while counting is switched on */
+static std::atomic<bool> counting{ false };
+static std::atomic<std::size_t> allocations{ 0 };
+
+void* operator new(std::size_t size) {
+    if (counting)
+        ++allocations;
+    if (void* p = std::malloc(size ? size : 1))
+        return p;
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept { std::free(p); }
+
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+
+SC_MODULE (test) {
+    SC_CTOR (test) { SC_THREAD(run); }
+
+    void log(int i) {
+        SCP_INFO(()) << "streamed message " << i;
+        SCP_INFO(())("formatted message {}", i);
+        SCP_DEBUG(()) << "suppressed message " << i;
+    }
+
+    void run() {
+        // warm up the logger caches and the per-thread buffers
+        for (int i = 0; i < 100; ++i)
+            log(i);
+        wait(1, sc_core::SC_NS);
+        for (int i = 0; i < 1000; ++i) {
+            counting = true;
+            log(i);
+            counting = false;
+            wait(1, sc_core::SC_NS);
+        }
+    }
+
+    SCP_LOGGER();
+};
+
+int sc_main(int argc, char** argv) {
+    scp::LoggingGuard logging_guard(scp::LogConfig()
+                                        .logLevel(scp::log::INFO)
+                                        .logAsync(false)
+                                        .directOutput(true)
+                                        .coloredOutput(false));
+    test toptest("top");
+    sc_core::sc_start();
+
+    std::cout << "Number of allocations: " << allocations << "\n";
+    return allocations != 0;
+}
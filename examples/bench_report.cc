@@ -0,0 +1,235 @@
+/*****************************************************************************
+  Licensed to Accellera Systems Initiative Inc. (Accellera) under one or
+  more contributor license agreements.  See the NOTICE file distributed
+  with this work for additional information regarding copyright ownership.
+  Accellera licenses this file to you under the Apache License, Version 2.0
+  (the "License"); you may not use this file except in compliance with the
+  License.  You may obtain a copy of the License at
+    http://www.apache.org/licenses/LICENSE-2.0
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+  implied.  See the License for the specific language governing
+  permissions and limitations under the License.
+ ****************************************************************************/
+
+/*
+ * Microbenchmarks of the report subsystem. The console output is discarded,
+ * the results are written as JSON to the file given as first argument
+ * (default: bench_report.json).
+ */
+
+#include <scp/report.h>
+
+#include <cci_configuration>
+#include <systemc>
+
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <limits>
+#include <memory>
+#include <string>
+#include <vector>
+
+struct bench_result {
+    std::string name;
+    size_t iterations;
+    double ns_per_op;
+};
+
+SC_MODULE (bench) {
+    SC_CTOR (bench) { SC_THREAD(run); }
+
+    std::vector<bench_result> results;
+
+    /* the time per call of f, after a warm up of a tenth of the calls. If
+     * drain is set the time includes writing all pending messages */
+    template <typename F>
+    void measure(const char* name, const scp::LogConfig& cfg, size_t n,
+                 F&& f, bool drain = false) {
+        scp::shutdown_logging();
+        scp::init_logging(cfg);
+        for (size_t i = 0; i < n / 10; ++i)
+            f(i);
+        auto start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < n; ++i)
+            f(i);
+        if (drain)
+            scp::shutdown_logging();
+        auto stop = std::chrono::steady_clock::now();
+        std::chrono::duration<double, std::nano> d = stop - start;
+        results.push_back({ name, n, d.count() / n });
+        if (drain)
+            scp::init_logging(cfg);
+    }
+
+    void run() {
+        const size_t disabled_n = 10000000;
+        const size_t enabled_n = 200000;
+        const std::string name = "bench.string";
+        auto base = scp::LogConfig()
+                        .logLevel(scp::log::INFO)
+                        .logAsync(false)
+                        .coloredOutput(false);
+
+        /* disabled path, i.e. the cost of the level check only */
+        measure("disabled_cached", base, disabled_n,
+                [this](size_t i) { SCP_DEBUG(()) << "value " << i; });
+        measure("disabled_literal", base, disabled_n, [this](size_t i) {
+            SCP_DEBUG("bench.literal") << "value " << i;
+        });
+        measure("disabled_string", base, disabled_n, [this, &name](size_t i) {
+            SCP_DEBUG(name) << "value " << i;
+        });
+
+        /* enabled path */
+        measure("enabled_stream", base, enabled_n,
+                [this](size_t i) { SCP_INFO(()) << "value " << i; });
+#ifdef FMT_SHARED
+        measure("enabled_fmt", base, enabled_n,
+                [this](size_t i) { SCP_INFO(())("value {}", i); });
+#endif
+        auto direct = scp::LogConfig(base).directOutput();
+        measure("enabled_stream_direct", direct, enabled_n,
+                [this](size_t i) { SCP_INFO(()) << "value " << i; });
+#ifdef FMT_SHARED
+        measure("enabled_fmt_direct", direct, enabled_n,
+                [this](size_t i) { SCP_INFO(())("value {}", i); });
+#endif
+
+        /* message composition for the LogConfig options */
+        struct option {
+            const char* name;
+            scp::LogConfig cfg;
+        };
+        std::vector<option> options{
+            { "compose_default", direct },
+            { "compose_no_sim_time",
+              scp::LogConfig(direct).printSimTime(false) },
+            { "compose_delta", scp::LogConfig(direct).printDelta(true) },
+            { "compose_no_type", scp::LogConfig(direct).msgTypeFieldWidth(0) },
+            { "compose_full_type",
+              scp::LogConfig(direct).msgTypeFieldWidth(
+                  std::numeric_limits<unsigned>::max()) },
+            { "compose_file_info", scp::LogConfig(direct).fileInfoFrom(0) },
+            { "compose_no_severity",
+              scp::LogConfig(direct).printSeverity(false) },
+            { "compose_colored", scp::LogConfig(direct).coloredOutput(true) },
+            { "compose_filter_glob",
+              scp::LogConfig(direct).logFilterRegex("^bench.*") },
+            { "compose_filter_regex",
+              scp::LogConfig(direct).logFilterRegex("^b(e|x)nch") },
+        };
+        for (auto& o : options)
+            measure(o.name, o.cfg, enabled_n, [this](size_t i) {
+                SCP_INFO(()) << "value " << i;
+            });
+
+        /* throughput until all messages are written */
+        measure(
+            "throughput_sync", direct, enabled_n,
+            [this](size_t i) { SCP_INFO(()) << "value " << i; }, true);
+        measure(
+            "throughput_async", scp::LogConfig(direct).logAsync(true),
+            enabled_n, [this](size_t i) { SCP_INFO(()) << "value " << i; },
+            true);
+#ifdef FMT_SHARED
+        measure(
+            "throughput_async_deferred",
+            scp::LogConfig(direct).logAsync(true).deferredFormatting(),
+            enabled_n, [this](size_t i) { SCP_INFO(())("value {}", i); },
+            true);
+#endif
+        scp::shutdown_logging();
+        scp::init_logging(base);
+    }
+
+    SCP_LOGGER();
+};
+
+/* a module whose loggers are resolved on first use or in the batch at the end
+ * of elaboration */
+SC_MODULE (owner) {
+    SC_CTOR (owner) {}
+
+    void touch() {
+        SCP_DEBUG(()) << "touch";
+        SCP_DEBUG((D)) << "touch";
+    }
+
+    SCP_LOGGER();
+    SCP_LOGGER((D), "detail");
+};
+
+/* the time per module of resolving the levels of its loggers, on first use
+ * or in one batch as done at the end of elaboration. The modules are kept in
+ * owners as they cannot be destroyed during elaboration */
+void measure_resolution(std::vector<bench_result>& results,
+                        std::vector<std::unique_ptr<owner>>& owners,
+                        size_t n) {
+    auto cfg = scp::LogConfig().logLevel(scp::log::INFO).logAsync(false);
+    for (bool batch : { false, true }) {
+        scp::shutdown_logging();
+        scp::init_logging(scp::LogConfig(cfg).resolveAtElaboration(batch));
+        auto first = owners.size();
+        for (size_t i = 0; i < n; ++i) {
+            auto name = (batch ? "batch_" : "lazy_") + std::to_string(i);
+            owners.emplace_back(new owner(name.c_str()));
+        }
+        auto start = std::chrono::steady_clock::now();
+        if (batch)
+            scp::resolve_registered_loggers();
+        else
+            for (auto i = first; i < owners.size(); ++i) owners[i]->touch();
+        auto stop = std::chrono::steady_clock::now();
+        std::chrono::duration<double, std::nano> d = stop - start;
+        results.push_back(
+            { batch ? "resolve_batch" : "resolve_lazy", n, d.count() / n });
+    }
+    scp::shutdown_logging();
+    scp::init_logging(cfg);
+}
+
+int sc_main(int argc, char** argv) {
+    std::string json = argc > 1 ? argv[1] : "bench_report.json";
+    // the console output would dominate the measurements
+    if (!std::freopen("/dev/null", "w", stdout))
+        return 1;
+    cci_utils::consuming_broker broker("global_broker");
+    cci_register_broker(broker);
+    // presets that are not consumed by any parameter, checked by each
+    // resolution unless the loggers are resolved in one batch
+    cci::cci_originator orig("config");
+    for (int i = 0; i < 200; ++i)
+        broker.set_preset_cci_value("unused_" + std::to_string(i) +
+                                        ".log_level",
+                                    cci::cci_value(4), orig);
+    broker.set_preset_cci_value("batch_1.log_level", cci::cci_value(5), orig);
+    broker.set_preset_cci_value("lazy_1.log_level", cci::cci_value(5), orig);
+
+    scp::LoggingGuard logging_guard(scp::LogConfig().logLevel(scp::log::INFO));
+    bench b("bench");
+    std::vector<std::unique_ptr<owner>> owners;
+    measure_resolution(b.results, owners, 2000);
+    sc_core::sc_start();
+
+    std::ofstream os(json);
+    os << "{\n  \"benchmark\": \"scp_report\",\n";
+#ifdef FMT_SHARED
+    os << "  \"fmt\": true,\n";
+#else
+    os << "  \"fmt\": false,\n";
+#endif
+    os << "  \"results\": [";
+    for (size_t i = 0; i < b.results.size(); ++i) {
+        auto& r = b.results[i];
+        os << (i ? ",\n" : "\n") << "    { \"name\": \"" << r.name
+           << "\", \"iterations\": " << r.iterations
+           << ", \"ns_per_op\": " << r.ns_per_op
+           << ", \"ops_per_sec\": " << 1e9 / r.ns_per_op << " }";
+    }
+    os << "\n  ]\n}\n";
+    std::cerr << "results written to " << json << "\n";
+    return os ? 0 : 1;
+}
@@ -0,0 +1,82 @@
+/*****************************************************************************
+  Licensed to Accellera Systems Initiative Inc. (Accellera) under one or
+  more contributor license agreements.  See the NOTICE file distributed
+  with this work for additional information regarding copyright ownership.
+  Accellera licenses this file to you under the Apache License, Version 2.0
+  (the "License"); you may not use this file except in compliance with the
+  License.  You may obtain a copy of the License at
+    http://www.apache.org/licenses/LICENSE-2.0
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+  implied.  See the License for the specific language governing
+  permissions and limitations under the License.
+ ****************************************************************************/
+
+#include <scp/report.h>
+
+#include <systemc>
+
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+/* writes the same messages as plain text file, as segmented text file and
+ * as segmented binary file and checks that the decoded segments match the
+ * plain text file */
+
+void write_log(const scp::LogConfig& cfg) {
+    scp::init_logging(cfg);
+    for (int i = 0; i < 200; ++i) {
+        SCP_INFO("test.info") << "streamed message " << i;
+        SCP_INFO("test.info")("formatted message {}", i);
+        SCP_DEBUG("test.a.very.long.message.type") << "debug message " << i;
+        SCP_WARN("test.warn") << "warning " << i;
+    }
+    SC_REPORT_WARNING("test.report", "reported warning");
+    scp::shutdown_logging();
+}
+
+auto read_file(const std::string& name) -> std::string {
+    std::ifstream is(name);
+    std::ostringstream os;
+    os << is.rdbuf();
+    return os.str();
+}
+
+auto decode_segments(const std::string& name) -> std::string {
+    std::ostringstream os;
+    for (int i = 0;; ++i) {
+        std::ifstream is(i ? name + "." + std::to_string(i) : name,
+                         std::ios::binary);
+        if (!is)
+            break;
+        if (!scp::decode_log_file(is, os))
+            return "corrupt segment " + std::to_string(i);
+    }
+    return os.str();
+}
+
+int sc_main(int argc, char** argv) {
+    auto cfg = scp::LogConfig()
+                   .logLevel(scp::log::DEBUG)
+                   .logAsync(false)
+                   .coloredOutput(false);
+    write_log(scp::LogConfig(cfg).logFileName("binary_report.log"));
+    write_log(scp::LogConfig(cfg)
+                  .logFileName("binary_report_text.log")
+                  .logFileSegmentSize(4096));
+    write_log(scp::LogConfig(cfg)
+                  .logFileName("binary_report_bin.log")
+                  .logFileSegmentSize(4096)
+                  .logFileBinary());
+
+    auto expected = read_file("binary_report.log");
+    auto text = decode_segments("binary_report_text.log");
+    auto binary = decode_segments("binary_report_bin.log");
+    std::cout << "plain: " << expected.size()
+              << " bytes, segmented text: " << text.size()
+              << " bytes, binary decoded: " << binary.size() << " bytes\n";
+    return expected.empty() || text != expected || binary != expected;
+}
@@ -0,0 +1,73 @@
+/*****************************************************************************
+  Licensed to Accellera Systems Initiative Inc. (Accellera) under one or
+  more contributor license agreements.  See the NOTICE file distributed
+  with this work for additional information regarding copyright ownership.
+  Accellera licenses this file to you under the Apache License, Version 2.0
+  (the "License"); you may not use this file except in compliance with the
+  License.  You may obtain a copy of the License at
+    http://www.apache.org/licenses/LICENSE-2.0
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+  implied.  See the License for the specific language governing
+  permissions and limitations under the License.
+ ****************************************************************************/
+
+/*
+ * Checks that the flight recorder takes every message of the SCP_ macros when
+ * they are passed to the report handler (directOutput(false)), also after a
+ * message the report handler drops for its verbosity.
+ */
+
+#include <scp/report.h>
+
+#include <cci_configuration>
+#include <systemc>
+
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <streambuf>
+#include <string>
+#include <unistd.h>
+
+int sc_main(int argc, char** argv) {
+    cci_utils::consuming_broker broker("global_broker");
+    cci_register_broker(broker);
+    cci::cci_originator orig("config");
+    // the logger passes the messages the report handler drops at log::NONE
+    broker.set_preset_cci_value("rec.log_level", cci::cci_value(5), orig);
+
+    std::string logfile = "/tmp/scp_record_report_test." +
+                          std::to_string(getpid());
+    {
+        scp::LoggingGuard logging_guard(scp::LogConfig()
+                                            .logLevel(scp::log::NONE)
+                                            .logAsync(false)
+                                            .printSimTime(false)
+                                            .directOutput(false)
+                                            .flightRecorder(8)
+                                            .logFileName(logfile));
+        SCP_DEBUG("rec") << "debug 1";
+        SCP_INFO("rec") << "info 2";
+        SCP_DEBUG("rec") << "debug 3";
+        SCP_INFO("rec") << "info 4";
+        scp::dump_flight_recorder();
+    }
+
+    std::ifstream lf(logfile);
+    std::string out((std::istreambuf_iterator<char>(lf)),
+                    std::istreambuf_iterator<char>());
+    std::remove(logfile.c_str());
+    std::cout << out;
+
+    auto dump = out.find("recorded messages:");
+    int errors = dump == std::string::npos;
+    for (auto msg : { "debug 1", "info 2", "debug 3", "info 4" }) {
+        if (dump == std::string::npos || out.find(msg, dump) == std::string::npos) {
+            std::cout << "not recorded: " << msg << "\n";
+            ++errors;
+        }
+    }
+    return errors;
+}
@@ -0,0 +1,128 @@
+/*****************************************************************************
+  Licensed to Accellera Systems Initiative Inc. (Accellera) under one or
+  more contributor license agreements.  See the NOTICE file distributed
+  with this work for additional information regarding copyright ownership.
+  Accellera licenses this file to you under the Apache License, Version 2.0
+  (the "License"); you may not use this file except in compliance with the
+  License.  You may obtain a copy of the License at
+    http://www.apache.org/licenses/LICENSE-2.0
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+  implied.  See the License for the specific language governing
+  permissions and limitations under the License.
+ ****************************************************************************/
+
+#include <scp/helpers.h>
+#include <scp/report.h>
+#include <scp/tlm_extensions/initiator_id.h>
+
+#include <systemc>
+#include <tlm>
+
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+int sc_main(int argc, char** argv) {
+    scp::LoggingGuard logging_guard(scp::LogConfig()
+                                        .logLevel(scp::log::INFO)
+                                        .logAsync(false)
+                                        .coloredOutput(false));
+    int errors = 0;
+    auto check = [&errors](const std::string& got, const std::string& exp) {
+        if (got != exp) {
+            std::cout << "expected: " << exp << "\n     got: " << got << "\n";
+            ++errors;
+        }
+    };
+
+    unsigned char data[200];
+    for (unsigned i = 0; i < sizeof(data); ++i)
+        data[i] = static_cast<unsigned char>(i * 37);
+    tlm::tlm_generic_payload trans;
+    trans.set_command(tlm::TLM_WRITE_COMMAND);
+    trans.set_address(0x1000);
+    trans.set_data_ptr(data);
+    trans.set_data_length(4);
+    trans.set_response_status(tlm::TLM_OK_RESPONSE);
+    const std::string exp =
+        "WRITE to address: 0x1000 len: 4 data: 0x6f4a2500 status: "
+        "TLM_OK_RESPONSE ";
+
+    check(scp::scp_txn_tostring(trans), exp);
+    std::ostringstream os;
+    os << scp::scp_txn_fmt(trans);
+    check(os.str(), exp);
+#ifdef FMT_SHARED
+    check(fmt::format("{}", scp::scp_txn_fmt(trans)), exp);
+#endif
+    char small[16];
+    check(std::to_string(scp::scp_txn_fmt(trans).format_to(small,
+                                                           sizeof(small))),
+          std::to_string(exp.size()));
+    check(small, exp.substr(0, sizeof(small) - 1));
+
+    // the data is written in pieces
+    trans.set_command(tlm::TLM_READ_COMMAND);
+    trans.set_data_length(sizeof(data));
+    std::string hex;
+    for (unsigned i = sizeof(data); i; --i) {
+        std::ostringstream b;
+        b << std::hex << std::setw(2) << std::setfill('0')
+          << static_cast<unsigned>(data[i - 1]);
+        hex += b.str();
+    }
+    check(scp::scp_txn_fmt(trans).str(),
+          "READ to address: 0x1000 len: c8 data: 0x" + hex +
+              " status: TLM_OK_RESPONSE ");
+
+    // head and tail of the data, byte enables and streaming width
+    trans.set_data_length(8);
+    check(scp::scp_txn_fmt(trans).maxDataBytes(3).str(),
+          "READ to address: 0x1000 len: 8 data: 0x03de...00 status: "
+          "TLM_OK_RESPONSE ");
+    unsigned char be[] = { tlm::TLM_BYTE_ENABLED, tlm::TLM_BYTE_DISABLED };
+    trans.set_byte_enable_ptr(be);
+    trans.set_byte_enable_length(sizeof(be));
+    trans.set_streaming_width(4);
+    check(scp::scp_txn_fmt(trans).maskByteEnables().str(),
+          "READ to address: 0x1000 len: 8 data: 0x--de--94--4a--00 "
+          "status: TLM_OK_RESPONSE ");
+    check(scp::scp_txn_fmt(trans).printStreamingWidth().str(),
+          "READ to address: 0x1000 len: 8 sw: 4 data: 0x03deb9946f4a2500 "
+          "status: TLM_OK_RESPONSE ");
+    trans.set_byte_enable_ptr(nullptr);
+    trans.set_byte_enable_length(0);
+    trans.set_streaming_width(8);
+
+    // the ... after the first bytes fills the first piece
+    trans.set_address(0);
+    trans.set_data_length(100);
+    check(scp::scp_txn_fmt(trans).maxDataBytes(90).str(),
+          "READ to address: 0x0 len: 64 data: 0x" + hex.substr(200, 90) +
+              "..." + hex.substr(310) + " status: TLM_OK_RESPONSE ");
+    trans.set_address(0x1000);
+
+    // extensions are printed by their registered printer
+    scp::tlm_extensions::initiator_id id(0x1234);
+    trans.set_extension(&id);
+    std::ostringstream idx;
+    idx << std::hex << scp::tlm_extensions::initiator_id::ID;
+    trans.set_data_length(1);
+    check(scp::scp_txn_fmt(trans).str(),
+          "READ to address: 0x1000 len: 1 data: 0x00 status: "
+          "TLM_OK_RESPONSE  extn:" +
+              idx.str());
+    scp::register_txn_extension_printer<scp::tlm_extensions::initiator_id>(
+        "initiator_id");
+    check(scp::scp_txn_fmt(trans).str(),
+          "READ to address: 0x1000 len: 1 data: 0x00 status: "
+          "TLM_OK_RESPONSE  initiator_id:0x1234");
+    trans.clear_extension(&id);
+
+    SCP_INFO("txn") << scp::scp_txn_fmt(trans);
+    std::cout << (errors ? "FAILED" : "PASSED") << "\n";
+    return errors != 0;
+}
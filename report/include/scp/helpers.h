@@ -21,38 +21,344 @@
 #include <tlm>
 #ifndef _SCP_HELPERS_H_
 #define _SCP_HELPERS_H_
+
+#include <algorithm>
+#include <cstring>
+#include <functional>
+#include <limits>
+#include <ostream>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#ifdef FMT_SHARED
+#include <fmt/format.h>
+#endif
+
 namespace scp {
-static std::string scp_txn_tostring(tlm::tlm_generic_payload& trans) {
-    std::stringstream info;
-    const char* cmd = "UNKOWN";
-    switch (trans.get_command()) {
-    case tlm::TLM_IGNORE_COMMAND:
-        cmd = "IGNORE";
-        break;
-    case tlm::TLM_WRITE_COMMAND:
-        cmd = "WRITE";
-        break;
-    case tlm::TLM_READ_COMMAND:
-        cmd = "READ";
-        break;
-    }
-    info << cmd << " to address: "
-         << "0x" << std::hex << trans.get_address();
-    info << " len: " << trans.get_data_length();
-    unsigned char* ptr = trans.get_data_ptr();
-    info << " data: 0x";
-    for (int i = trans.get_data_length(); i; i--) {
-        info << std::setw(2) << std::setfill('0') << std::hex
-             << (unsigned int)(ptr[i - 1]);
-    }
-    info << " status: " << trans.get_response_string() << " ";
-    for (unsigned int i = 0; i < tlm::max_num_extensions(); i++) {
-        if (trans.get_extension(i)) {
-            info << " extn:" << i;
+/**
+ * @brief a printer of an extension registered with
+ * register_txn_extension_printer()
+ */
+struct txn_extension_printer {
+    const char* name{ nullptr };
+    std::function<void(const tlm::tlm_extension_base&, std::string&)> print;
+};
+
+/**
+ * @fn std::vector<txn_extension_printer>& txn_extension_printers()
+ * @brief the registered printers indexed by the extension ID
+ */
+inline std::vector<txn_extension_printer>& txn_extension_printers() {
+    static std::vector<txn_extension_printer> printers;
+    return printers;
+}
+
+/**
+ * @fn void register_txn_extension_printer(const char*, F)
+ * @brief print the content of the extension EXT instead of its index
+ *
+ * The printer is only called when a payload carrying the extension is
+ * printed, e.g. register_txn_extension_printer<my_ext>("my_ext",
+ * [](const my_ext& e, std::string& s) { s += e.name(); })
+ *
+ * @param name the name printed in front of the content
+ * @param print the function appending the content to the string
+ */
+template <typename EXT, typename F>
+void register_txn_extension_printer(const char* name, F print) {
+    auto id = tlm::tlm_extension<EXT>::ID;
+    auto& printers = txn_extension_printers();
+    if (printers.size() <= id)
+        printers.resize(id + 1);
+    printers[id].name = name;
+    printers[id].print = [print](const tlm::tlm_extension_base& ext,
+                                 std::string& str) {
+        print(static_cast<const EXT&>(ext), str);
+    };
+}
+
+namespace detail {
+template <typename EXT>
+auto print_extension(const EXT& ext, std::string& str, int)
+    -> decltype(str += ext.to_string(), void()) {
+    str += ext.to_string();
+}
+template <typename EXT>
+auto print_extension(const EXT& ext, std::string& str, long)
+    -> decltype(static_cast<uint64_t>(ext), void()) {
+    auto val = static_cast<uint64_t>(ext);
+    char tmp[16];
+    char* t = tmp + sizeof(tmp);
+    do {
+        *--t = "0123456789abcdef"[val & 0xf];
+        val >>= 4;
+    } while (val);
+    str += "0x";
+    str.append(t, tmp + sizeof(tmp));
+}
+} // namespace detail
+
+/**
+ * @fn void register_txn_extension_printer(const char*)
+ * @brief print the content of the extension EXT using its to_string()
+ * member or, if it has none, its value as uint64_t in hex, e.g.
+ * register_txn_extension_printer<tlm_extensions::initiator_id>("id")
+ *
+ * @param name the name printed in front of the content
+ */
+template <typename EXT>
+void register_txn_extension_printer(const char* name) {
+    register_txn_extension_printer<EXT>(
+        name, [](const EXT& ext, std::string& str) {
+            detail::print_extension(ext, str, 0);
+        });
+}
+
+/**
+ * @class scp_txn_formatter
+ * @brief formats a generic payload when it is printed
+ *
+ * The object only holds a reference to the payload, so creating it costs
+ * nothing. The text is written in pieces of at most 128 characters, which
+ * are either streamed, passed to fmt or copied into a buffer of the caller,
+ * without any allocation. The payload must not be changed before the object
+ * is printed.
+ *
+ * By default the complete data is printed. maxDataBytes() limits it to the
+ * first and last bytes, maskByteEnables() prints the disabled bytes as --,
+ * printStreamingWidth() adds the streaming width if it is smaller than the
+ * data length.
+ * Extensions with a registered printer (see
+ * register_txn_extension_printer()) are printed with their content.
+ */
+class scp_txn_formatter
+{
+public:
+    explicit scp_txn_formatter(const tlm::tlm_generic_payload& trans):
+        trans(trans) {}
+
+    //! print at most count data bytes, half of them from the start and half
+    //! from the end of the data
+    scp_txn_formatter& maxDataBytes(size_t count) {
+        max_bytes = count;
+        return *this;
+    }
+    //! enable/disable printing the bytes disabled by the byte enables as --
+    scp_txn_formatter& maskByteEnables(bool enable = true) {
+        mask = enable;
+        return *this;
+    }
+    //! enable/disable printing a streaming width smaller than the data
+    //! length as sw:
+    scp_txn_formatter& printStreamingWidth(bool enable = true) {
+        streaming_width = enable;
+        return *this;
+    }
+
+    /**
+     * @fn void write(OUT&&) const
+     * @brief pass the text in pieces to out
+     *
+     * @param out the function called with a pointer to the characters and
+     * their number
+     */
+    template <typename OUT>
+    void write(OUT&& out) const {
+        char buf[128];
+        char* p = buf;
+        auto put = [&p](const char* str) {
+            auto len = std::strlen(str);
+            std::memcpy(p, str, len);
+            p += len;
+        };
+        switch (trans.get_command()) {
+        case tlm::TLM_IGNORE_COMMAND:
+            put("IGNORE");
+            break;
+        case tlm::TLM_WRITE_COMMAND:
+            put("WRITE");
+            break;
+        case tlm::TLM_READ_COMMAND:
+            put("READ");
+            break;
+        default:
+            put("UNKOWN");
+        }
+        put(" to address: 0x");
+        p = put_hex(p, trans.get_address());
+        put(" len: ");
+        size_t len = trans.get_data_length();
+        p = put_hex(p, len);
+        auto width = trans.get_streaming_width();
+        if (streaming_width && width && width < len) {
+            put(" sw: ");
+            p = put_hex(p, width);
         }
+        put(" data: 0x");
+        const unsigned char* data = trans.get_data_ptr();
+        const unsigned char* be = mask ? trans.get_byte_enable_ptr() : nullptr;
+        size_t be_len = be ? trans.get_byte_enable_length() : 0;
+        // passes buf on if fewer than n characters are left
+        auto reserve = [&](size_t n) {
+            if (p + n > buf + sizeof(buf)) {
+                out(buf, p - buf);
+                p = buf;
+            }
+        };
+        auto put_bytes = [&](size_t from, size_t to) {
+            // the bytes are printed from the highest address down
+            for (auto i = from; i > to;) {
+                reserve(2);
+                --i;
+                auto disabled = be_len &&
+                                be[i % be_len] == tlm::TLM_BYTE_DISABLED;
+                auto digits = disabled ? "--" : hex_digits() + 2 * data[i];
+                *p++ = digits[0];
+                *p++ = digits[1];
+            }
+        };
+        if (len > max_bytes) {
+            put_bytes(len, len - (max_bytes - max_bytes / 2));
+            reserve(3);
+            put("...");
+            put_bytes(max_bytes / 2, 0);
+        } else
+            put_bytes(len, 0);
+        out(buf, p - buf);
+        out(" status: ", 9);
+        auto status = trans.get_response_string();
+        out(status.data(), status.size());
+        out(" ", 1);
+        auto& printers = txn_extension_printers();
+        for (unsigned i = 0, n = tlm::max_num_extensions(); i < n; i++) {
+            auto ext = trans.get_extension(i);
+            if (!ext)
+                continue;
+            if (i < printers.size() && printers[i].print) {
+                thread_local std::string text;
+                text.assign(" ");
+                text.append(printers[i].name);
+                text.push_back(':');
+                printers[i].print(*ext, text);
+                out(text.data(), text.size());
+            } else {
+                p = buf;
+                put(" extn:");
+                p = put_hex(p, i);
+                out(buf, p - buf);
+            }
+        }
+    }
+
+    /**
+     * @fn size_t format_to(char*, size_t) const
+     * @brief write the text into a buffer
+     *
+     * The text is truncated to size - 1 characters and terminated by a zero
+     * if size is not 0.
+     *
+     * @param buf the buffer
+     * @param size the size of the buffer
+     * @return the length of the complete text
+     */
+    size_t format_to(char* buf, size_t size) const {
+        size_t len = 0;
+        write([buf, size, &len](const char* str, size_t n) {
+            if (len + 1 < size)
+                std::memcpy(buf + len, str, std::min(n, size - 1 - len));
+            len += n;
+        });
+        if (size)
+            buf[std::min(len, size - 1)] = '\0';
+        return len;
+    }
+
+    //! the text as string
+    std::string str() const {
+        std::string text;
+        write([&text](const char* str, size_t n) { text.append(str, n); });
+        return text;
     }
-    return info.str();
+
+private:
+    //! the two hex digits of each byte value
+    static const char* hex_digits() {
+        static const char digits[] =
+            "000102030405060708090a0b0c0d0e0f101112131415161718191a1b1c1d1e1f"
+            "202122232425262728292a2b2c2d2e2f303132333435363738393a3b3c3d3e3f"
+            "404142434445464748494a4b4c4d4e4f505152535455565758595a5b5c5d5e5f"
+            "606162636465666768696a6b6c6d6e6f707172737475767778797a7b7c7d7e7f"
+            "808182838485868788898a8b8c8d8e8f909192939495969798999a9b9c9d9e9f"
+            "a0a1a2a3a4a5a6a7a8a9aaabacadaeafb0b1b2b3b4b5b6b7b8b9babbbcbdbebf"
+            "c0c1c2c3c4c5c6c7c8c9cacbcccdcecfd0d1d2d3d4d5d6d7d8d9dadbdcdddedf"
+            "e0e1e2e3e4e5e6e7e8e9eaebecedeeeff0f1f2f3f4f5f6f7f8f9fafbfcfdfeff";
+        return digits;
+    }
+
+    //! writes val in hex without leading zeros
+    static char* put_hex(char* p, uint64_t val) {
+        char tmp[16];
+        char* t = tmp + sizeof(tmp);
+        do {
+            *--t = "0123456789abcdef"[val & 0xf];
+            val >>= 4;
+        } while (val);
+        auto len = tmp + sizeof(tmp) - t;
+        std::memcpy(p, t, len);
+        return p + len;
+    }
+
+    const tlm::tlm_generic_payload& trans;
+    size_t max_bytes{ std::numeric_limits<size_t>::max() };
+    bool mask{ false };
+    bool streaming_width{ false };
+};
+
+/**
+ * @fn scp_txn_formatter scp_txn_fmt(const tlm::tlm_generic_payload&)
+ * @brief describe a generic payload, the text is only built if the result
+ * is printed, e.g. SCP_TRACE(()) << scp::scp_txn_fmt(trans)
+ *
+ * @param trans the payload
+ * @return the formatter
+ */
+inline scp_txn_formatter scp_txn_fmt(const tlm::tlm_generic_payload& trans) {
+    return scp_txn_formatter(trans);
+}
+
+inline std::ostream& operator<<(std::ostream& os,
+                                const scp_txn_formatter& txn) {
+    txn.write([&os](const char* str, size_t n) {
+        os.write(str, static_cast<std::streamsize>(n));
+    });
+    return os;
+}
+
+static std::string scp_txn_tostring(tlm::tlm_generic_payload& trans) {
+    return scp_txn_formatter(trans).str();
 }
 
 } // namespace scp
-#endif /* _SCP_HELPERS_H_ */
\ No newline at end of file
+
+#ifdef FMT_SHARED
+namespace fmt {
+template <>
+struct formatter<scp::scp_txn_formatter> {
+    constexpr auto parse(format_parse_context& ctx) -> decltype(ctx.begin()) {
+        return ctx.begin();
+    }
+    template <typename FormatContext>
+    auto format(const scp::scp_txn_formatter& txn, FormatContext& ctx) const
+        -> decltype(ctx.out()) {
+        auto out = ctx.out();
+        txn.write([&out](const char* str, size_t n) {
+            out = std::copy(str, str + n, out);
+        });
+        return out;
+    }
+};
+} // namespace fmt
+#endif
+
+#endif /* _SCP_HELPERS_H_ */
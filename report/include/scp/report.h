@@ -17,15 +17,20 @@
 #ifndef _SCP_REPORT_H_
 #define _SCP_REPORT_H_
 
+#include <cstdint>
 #include <cstring>
 #include <iomanip>
 #include <iostream>
 #include <sstream>
 #include <array>
+#include <atomic>
 #include <numeric>
 #include <vector>
 #include <numeric>
 #include <functional>
+#include <tuple>
+#include <type_traits>
+#include <utility>
 
 #ifdef __GNUG__
 #include <cstdlib>
@@ -80,6 +85,20 @@ enum class log {
     DBGTRACE = TRACEALL
 };
 
+//! \brief enum defining the format of the log output
+enum class log_format {
+    TEXT, //!< the human readable text
+    JSON, //!< one JSON object per line
+    CSV   //!< one line of comma separated values, preceded by a header line
+};
+
+//! \brief enum defining the behavior of the asynchronous output if its
+//! queue is full
+enum class async_overflow {
+    BLOCK,         //!< wait until the output thread has freed a slot
+    OVERRUN_OLDEST //!< discard the oldest queued message
+};
+
 /**
  * @fn log as_log(int)
  * @brief safely convert an integer into a log level
@@ -147,6 +166,28 @@ void init_logging(log level = log::WARNING, unsigned type_field_width = 24,
  * @param print_time whether to print the system time stamp
  */
 void reinit_logging(log level = log::WARNING);
+/**
+ * @struct LogSink
+ * @brief the configuration of one output of the logging
+ *
+ * A sink writes either to the console (SC_DISPLAY action) or to a file
+ * (SC_LOG action). The class follows the builder pattern.
+ */
+struct LogSink {
+    std::string file_name{ "" };
+    log level{ log::TRACEALL };
+    std::string filter_regex{ "" };
+    log_format format{ log_format::TEXT };
+
+    //! set the file to write to, an empty name selects the console
+    LogSink& fileName(const std::string&);
+    //! set the least severe level written to this sink
+    LogSink& logLevel(log);
+    //! set the regular expression to filter the output of this sink
+    LogSink& logFilterRegex(const std::string&);
+    //! set the format of this sink
+    LogSink& logFormat(log_format);
+};
 /**
  * @struct LogConfig
  * @brief the configuration class for the logging setup
@@ -163,10 +204,27 @@ struct LogConfig {
     bool print_severity{ true };
     bool colored_output{ true };
     std::string log_file_name{ "" };
+    size_t log_file_segment_size{ 0 };
+    unsigned log_file_segments{ 0 };
+    bool log_file_binary{ false };
+    log_format output_format{ log_format::TEXT };
+    std::vector<LogSink> sinks;
+    unsigned rate_limit{ 0 };
+    sc_core::sc_time rate_limit_window{ sc_core::SC_ZERO_TIME };
+    bool rate_limit_by_type{ false };
+    size_t flight_recorder_size{ 0 };
+    log flight_recorder_level{ log::DEBUG };
+    bool collect_statistics{ false };
     std::string log_filter_regex{ "" };
     bool log_async{ true };
+    size_t async_queue_size{ 1024 };
+    unsigned async_thread_count{ 1 };
+    async_overflow async_overflow_policy{ async_overflow::BLOCK };
     bool report_only_first_error{ false };
     int file_info_from{ sc_core::SC_INFO };
+    bool direct_output{ false };
+    bool deferred_formatting{ false };
+    bool resolve_at_elaboration{ false };
 
     //! set the logging level
     LogConfig& logLevel(log);
@@ -183,20 +241,66 @@ struct LogConfig {
     LogConfig& printSeverity(bool = true);
     //! enable/disable colored output
     LogConfig& coloredOutput(bool = true);
+    //! set the format of the console and file output
+    LogConfig& logFormat(log_format);
+    //! limit the number of info and warning messages per call site to count
+    //! per window of simulation time (SC_ZERO_TIME for the whole
+    //! simulation), 0 disables the limit
+    LogConfig& rateLimit(unsigned count,
+                         sc_core::sc_time window = sc_core::SC_ZERO_TIME);
+    //! enable/disable applying the rate limit per message type instead of
+    //! per call site
+    LogConfig& rateLimitByType(bool = true);
+    //! keep the last entries messages up to level of each thread, also
+    //! those above the logging level, and write them before an error (see
+    //! dump_flight_recorder()), 0 disables the recorder
+    LogConfig& flightRecorder(size_t entries, log level = log::DEBUG);
+    //! enable/disable counting the messages, bytes and output costs per
+    //! message type (see get_log_statistics())
+    LogConfig& collectStatistics(bool = true);
+    //! add an output, if none is added the console and the file set by
+    //! logFileName() are used
+    LogConfig& addSink(const LogSink&);
     //! set the file name for the log output file
     LogConfig& logFileName(std::string&&);
     //! set the file name for the log output file
     LogConfig& logFileName(const std::string&);
+    //! write the log file through a memory mapping in segments of the given
+    //! size in bytes, 0 to write it as a single plain file
+    LogConfig& logFileSegmentSize(size_t);
+    //! set the number of segments of the log file to keep, 0 to keep all
+    LogConfig& logFileSegments(unsigned);
+    //! enable/disable writing the segments of the log file in the binary
+    //! format (see decode_log_file())
+    LogConfig& logFileBinary(bool = true);
     //! set the regular expression to filter the output
     LogConfig& logFilterRegex(std::string&&);
     //! set the regular expression to filter the output
     LogConfig& logFilterRegex(const std::string&);
     //! enable/disable asynchronous output (write to file in separate thread
     LogConfig& logAsync(bool = true);
+    //! set the number of messages the queue of the asynchronous output can
+    //! hold
+    LogConfig& asyncQueueSize(size_t);
+    //! set the number of output threads, with more than one thread the
+    //! messages may be written out of order
+    LogConfig& asyncThreadCount(unsigned);
+    //! set the behavior if the queue of the asynchronous output is full
+    LogConfig& asyncOverflowPolicy(async_overflow);
     //! disable the printing of the file name from this level upwards.
     LogConfig& fileInfoFrom(int);
     //! disable/enable the supression of all error messages after the first
     LogConfig& reportOnlyFirstError(bool = true);
+    //! enable/disable passing SC_INFO messages of the SCP_ macros directly to
+    //! the output, bypassing sc_report_handler::report
+    LogConfig& directOutput(bool = true);
+    //! enable/disable formatting of SC_INFO messages using the FMT form in
+    //! the output thread
+    LogConfig& deferredFormatting(bool = true);
+    //! enable/disable resolving the level of all loggers created by
+    //! SCP_LOGGER and SCP_LOGGER_VECTOR in one batch at the end of
+    //! elaboration
+    LogConfig& resolveAtElaboration(bool = true);
 };
 
 /**
@@ -207,6 +311,11 @@ struct scp_logger_cache {
     sc_core::sc_verbosity level = sc_core::SC_UNSET;
     std::string type;
     std::vector<std::string> features;
+    //! the log level epoch the level has been resolved in
+    uint32_t epoch = 0;
+    //! the larger of level and flight_recorder_verbosity, a message above it
+    //! is dropped with a single compare
+    sc_core::sc_verbosity gate = sc_core::SC_UNSET;
 
     /**
      * @brief Initialize the verbosity cache and/or return the cached value.
@@ -216,6 +325,86 @@ struct scp_logger_cache {
     sc_core::sc_verbosity get_log_verbosity_cached(const char*, const char*);
 };
 
+/**
+ * @fn bool batch_resolution_enabled()
+ * @brief check if loggers are resolved at the end of elaboration (see
+ * LogConfig::resolveAtElaboration)
+ *
+ * @return true if loggers shall register themselves
+ */
+bool batch_resolution_enabled();
+/**
+ * @brief the work shared by the loggers resolved in one batch at the end of
+ * elaboration, handed to each registered function
+ */
+class logger_resolution;
+/**
+ * @fn void register_logger(const void*, std::function<void(logger_resolution&)>)
+ * @brief register a function resolving one or more loggers at the end of
+ * elaboration
+ *
+ * @param key the registration, used to unregister it
+ * @param resolve the function calling resolve_logger()
+ */
+void register_logger(const void* key,
+                     std::function<void(logger_resolution&)> resolve);
+/**
+ * @fn void unregister_logger(const void*)
+ * @brief remove a registration if it has not been resolved yet
+ *
+ * @param key the registration
+ */
+void unregister_logger(const void* key);
+/**
+ * @fn void resolve_logger(logger_resolution&, scp_logger_cache&, const char*, const char*)
+ * @brief resolve the level of a logger as part of the batch at the end of
+ * elaboration, using the broker of its owner.
+ *
+ * @param batch the batch the logger is resolved in
+ * @param cache the logger
+ * @param scname the SystemC hierarchical name of the owner
+ * @param tname the type name of the owner
+ */
+void resolve_logger(logger_resolution& batch, scp_logger_cache& cache,
+                    const char* scname, const char* tname);
+/**
+ * @fn void resolve_registered_loggers()
+ * @brief resolve the loggers registered so far in one batch, as done at the
+ * end of elaboration
+ */
+void resolve_registered_loggers();
+
+/**
+ * @brief registers the logger(s) of an SCP_LOGGER or SCP_LOGGER_VECTOR for
+ * the resolution at the end of elaboration. Nothing is registered unless
+ * LogConfig::resolveAtElaboration is set. A copy is not registered, its
+ * logger is resolved on first use.
+ */
+class scp_logger_registration
+{
+public:
+    template <typename F,
+              typename = std::enable_if_t<!std::is_same<
+                  std::decay_t<F>, scp_logger_registration>::value>>
+    explicit scp_logger_registration(F&& resolve) {
+        if (batch_resolution_enabled()) {
+            register_logger(this, std::forward<F>(resolve));
+            registered = true;
+        }
+    }
+    scp_logger_registration(const scp_logger_registration&) {}
+    scp_logger_registration& operator=(const scp_logger_registration&) {
+        return *this;
+    }
+    ~scp_logger_registration() {
+        if (registered)
+            unregister_logger(this);
+    }
+
+private:
+    bool registered{ false };
+};
+
 /**
  * @fn void init_logging(const LogConfig&)
  * @brief initializes the SystemC logging system with a particular
@@ -258,6 +447,84 @@ void set_cycle_base(sc_core::sc_time period);
  * static destruction on Windows.
  */
 void shutdown_logging();
+/**
+ * @fn void flush_logging()
+ * @brief write all pending messages and wait until they are written
+ *
+ * This is done as well before the SC_STOP, SC_ABORT and SC_THROW actions of
+ * a report are executed.
+ */
+void flush_logging();
+/**
+ * @fn void dump_flight_recorder()
+ * @brief write the messages kept by the flight recorder of the calling
+ * thread and empty it (see LogConfig::flightRecorder())
+ *
+ * This is done as well before an SC_ERROR or SC_FATAL report is written.
+ */
+void dump_flight_recorder();
+/**
+ * @struct log_statistics
+ * @brief the counters of one message type, collected if
+ * LogConfig::collectStatistics() is enabled
+ *
+ * For the SCP_ macros the message type is the name of the logger. The costs
+ * are measured for every 16th message of a type and scaled.
+ */
+struct log_statistics {
+    std::string msg_type;
+    //! the messages written to at least one sink
+    uint64_t written{ 0 };
+    //! the messages passed to the report handler but not written, e.g. due
+    //! to the level or filter of the sinks or the rate limit
+    uint64_t filtered{ 0 };
+    //! the size of the composed messages summed over the sinks
+    uint64_t bytes{ 0 };
+    //! the estimated time composing (or encoding) the messages in ns
+    uint64_t compose_ns{ 0 };
+    //! the estimated time spent in the calls of the loggers in ns
+    uint64_t output_ns{ 0 };
+};
+/**
+ * @fn std::vector<log_statistics> get_log_statistics()
+ * @brief get the statistics of the messages reported by the calling thread
+ *
+ * The statistics are written as table by shutdown_logging().
+ *
+ * @return the counters per message type, sorted by the number of bytes
+ */
+std::vector<log_statistics> get_log_statistics();
+/**
+ * @fn void reset_log_statistics()
+ * @brief clear the statistics of the calling thread
+ */
+void reset_log_statistics();
+/**
+ * @fn size_t get_dropped_messages()
+ * @brief get the number of messages discarded by the asynchronous output
+ *
+ * Messages are only discarded if the overflow policy is
+ * async_overflow::OVERRUN_OLDEST and the queue is full. The count is
+ * reported as warning by shutdown_logging().
+ *
+ * @return the number of discarded messages since the logging has been
+ * initialized
+ */
+size_t get_dropped_messages();
+/**
+ * @fn bool decode_log_file(std::istream&, std::ostream&)
+ * @brief convert a segment of a log file written with
+ * LogConfig::logFileSegmentSize() into text
+ *
+ * Binary segments (see LogConfig::logFileBinary()) are printed as they would
+ * have been written in text format, text segments are copied up to the
+ * unused rest of the segment.
+ *
+ * @param is the stream holding the segment
+ * @param os the stream receiving the text
+ * @return false if the segment is truncated or corrupt
+ */
+bool decode_log_file(std::istream& is, std::ostream& os);
 /**
  * @class LoggingGuard
  * @brief RAII wrapper for logging initialization and cleanup
@@ -360,12 +627,565 @@ inline sc_core::sc_verbosity get_log_verbosity(std::string const& t) {
     return get_log_verbosity(t.c_str());
 }
 
+/**
+ * @brief the log level epoch, it is incremented whenever the verbosity of
+ * the message types may have changed (e.g. by set_logging_level()).
+ */
+extern std::atomic<uint32_t> log_level_epoch;
+
+/**
+ * @brief the verbosity up to which the flight recorder takes the messages of
+ * the SCP_ macros which are above the level of their logger, 0 if it is
+ * disabled (see LogConfig::flightRecorder())
+ */
+extern std::atomic<int> flight_recorder_verbosity;
+/**
+ * @fn bool record_only()
+ * @brief called by the SCP_ macros for a message above the level of its
+ * logger but within flight_recorder_verbosity. The message is then only
+ * recorded, no report is created for it.
+ *
+ * @return true if the flight recorder of the calling thread is enabled
+ */
+bool record_only();
+
+/**
+ * @brief the outcome of the level check of an SCP_ report macro
+ */
+enum class log_check {
+    SKIP,  //!< the message is dropped
+    LOG,   //!< the message is within the level of its logger
+    RECORD //!< the message is only taken by the flight recorder
+};
+/**
+ * @fn log_check log_or_record(int, int)
+ * @brief the level check of a message which is within the gate (the larger of
+ * the level of its logger and flight_recorder_verbosity)
+ *
+ * @param level the level of the logger
+ * @param lvl the verbosity of the message
+ */
+inline log_check log_or_record(int level, int lvl) {
+    return level >= lvl    ? log_check::LOG
+           : record_only() ? log_check::RECORD
+                           : log_check::SKIP;
+}
+/**
+ * @fn log_check check_log_level(int, int)
+ * @brief the level check of a message against a level which is not cached
+ * with its gate
+ *
+ * @param level the level of the logger
+ * @param lvl the verbosity of the message
+ */
+inline log_check check_log_level(int level, int lvl) {
+    return level >= lvl ||
+                   flight_recorder_verbosity.load(std::memory_order_relaxed) >=
+                       lvl
+               ? log_or_record(level, lvl)
+               : log_check::SKIP;
+}
+/**
+ * @fn bool log_check_passed(log_check, F&&)
+ * @brief true if the message of an SCP_ report macro is composed, rate is
+ * only called for a message within the level of its logger
+ */
+template <typename F>
+inline bool log_check_passed(log_check c, F&& rate) {
+    return c == log_check::LOG ? rate() : c == log_check::RECORD;
+}
+
+/**
+ * @brief verbosity cache of a single SCP_ report macro call site. For a
+ * string literal feature it holds the epoch the verbosity has been resolved
+ * in, the gate (the larger of the verbosity and flight_recorder_verbosity)
+ * and the verbosity, so the steady state check of a disabled message is two
+ * loads and two compares. The cache belongs to the first array passed at the call site,
+ * other arrays (e.g. names taken from a table) as well as other features
+ * (e.g. a std::string or SCMOD) are looked up on every call.
+ */
+struct verbosity_site {
+    std::atomic<uint64_t> state{ 0 };
+    //! the array the state belongs to, it is set once
+    std::atomic<const char*> name{ nullptr };
+
+    //! get the global verbosity level
+    sc_core::sc_verbosity get() { return get_log_verbosity(); }
+    //! get the cached verbosity level of a string literal
+    template <std::size_t N>
+    sc_core::sc_verbosity get(const char (&t)[N]) {
+        auto s = state.load(std::memory_order_relaxed);
+        if ((s >> 32) == log_level_epoch.load(std::memory_order_relaxed) &&
+            name.load(std::memory_order_relaxed) == t)
+            return static_cast<sc_core::sc_verbosity>(s & 0xffff);
+        return resolve(t);
+    }
+    //! get the verbosity level of a (mutable) character array
+    template <std::size_t N>
+    sc_core::sc_verbosity get(char (&t)[N]) {
+        return get_log_verbosity(t);
+    }
+    //! get the verbosity level of any other name
+    template <typename T>
+    sc_core::sc_verbosity get(const T& t) {
+        return get_log_verbosity(t);
+    }
+
+    //! check a message of verbosity LVL against the global verbosity level
+    template <int LVL> log_check check() {
+        return check_log_level(get(), LVL);
+    }
+    //! check a message of verbosity LVL against the cached gate of a string
+    //! literal
+    template <int LVL, std::size_t N> log_check check(const char (&t)[N]) {
+        auto s = state.load(std::memory_order_relaxed);
+        if ((s >> 32) != log_level_epoch.load(std::memory_order_relaxed) ||
+            name.load(std::memory_order_relaxed) != t)
+            return check_log_level(resolve(t), LVL);
+        return static_cast<int>((s >> 16) & 0xffff) >= LVL
+                   ? log_or_record(static_cast<int>(s & 0xffff), LVL)
+                   : log_check::SKIP;
+    }
+    //! check a message of verbosity LVL against the verbosity level of a
+    //! (mutable) character array
+    template <int LVL, std::size_t N> log_check check(char (&t)[N]) {
+        return check_log_level(get(t), LVL);
+    }
+    //! check a message of verbosity LVL against the verbosity level of any
+    //! other name
+    template <int LVL, typename T> log_check check(const T& t) {
+        return check_log_level(get(t), LVL);
+    }
+
+    /**
+     * @brief resolve the verbosity of the feature and cache it if the site
+     * belongs to it
+     *
+     * @return sc_core::sc_verbosity
+     */
+    sc_core::sc_verbosity resolve(char const* t);
+};
+
 /**
  * @brief Return list of logging parameters that have been used
  *
  */
 std::vector<std::string> get_logging_parameters();
 
+/**
+ * @struct deferred_message
+ * @brief a FMT message whose formatting has been postponed
+ *
+ * The message holds a pointer to the format string and a copy of the
+ * arguments in a fixed size buffer. Only arithmetic and enum arguments are
+ * stored this way as their value cannot change or dangle until the message is
+ * formatted. The format string is only kept beyond the statement creating the
+ * message if it is static, i.e. if format_id is not no_format_id.
+ */
+struct deferred_message {
+    //! the maximum size of the packed arguments
+    static constexpr std::size_t capacity = 64;
+    //! the format_id of a message which must be formatted right away
+    static constexpr std::uint32_t no_format_id = ~0U;
+    //! function appending the formatted message to a string
+    using format_fn = void (*)(std::string&, const char*, std::size_t,
+                               const unsigned char*);
+
+    format_fn format{ nullptr };
+    //! the index of format in the functions known to register_deferred_format()
+    std::uint32_t format_id{ no_format_id };
+    const char* fmt{ nullptr };
+    std::size_t fmt_size{ 0 };
+    std::size_t size{ 0 };
+    unsigned char args[capacity];
+
+    /**
+     * @fn void format_to(std::string&)
+     * @brief append the formatted message
+     *
+     * @param out the string to append to
+     */
+    void format_to(std::string& out) const {
+        format(out, fmt, fmt_size, args);
+    }
+};
+/**
+ * @fn std::uint32_t register_deferred_format(deferred_message::format_fn)
+ * @brief make a format function known to the logging thread, which looks the
+ * function of a deferred message up by its index
+ *
+ * @param format the function
+ * @return its index, deferred_message::no_format_id if no more functions can
+ * be registered
+ */
+std::uint32_t register_deferred_format(deferred_message::format_fn format);
+/**
+ * @class log_buffer
+ * @brief stream buffer appending to a string which keeps its capacity
+ *
+ * In contrast to std::stringbuf the collected characters can be accessed
+ * without copying them and clearing the buffer does not release the memory.
+ */
+class log_buffer : public std::streambuf
+{
+public:
+    //! drop the collected characters but keep the allocated memory
+    void clear() { buf.clear(); }
+    //! the collected characters
+    std::string& str() { return buf; }
+
+protected:
+    int_type overflow(int_type c) override {
+        if (!traits_type::eq_int_type(c, traits_type::eof()))
+            buf.push_back(traits_type::to_char_type(c));
+        return traits_type::not_eof(c);
+    }
+    std::streamsize xsputn(const char_type* s, std::streamsize n) override {
+        buf.append(s, static_cast<std::size_t>(n));
+        return n;
+    }
+
+private:
+    std::string buf;
+};
+/**
+ * @class log_stream
+ * @brief output stream writing into a log_buffer
+ */
+class log_stream : public std::ostream
+{
+public:
+    log_stream(): std::ostream(&sb) {}
+    /**
+     * @fn void reset()
+     * @brief clear the content and restore the default formatting state
+     */
+    void reset() {
+        sb.clear();
+        pending.format = nullptr;
+        clear();
+        flags(std::ios_base::skipws | std::ios_base::dec);
+        fill(' ');
+        width(0);
+        precision(6);
+    }
+    /**
+     * @fn void defer(const deferred_message&)
+     * @brief add a message to be formatted later
+     *
+     * The message is kept unformatted if it is the only content of the
+     * stream and its format string is static, otherwise it is formatted right
+     * away.
+     *
+     * @param msg the message
+     */
+    void defer(const deferred_message& msg) {
+        if (!pending.format && sb.str().empty() &&
+            msg.format_id != deferred_message::no_format_id)
+            pending = msg;
+        else
+            msg.format_to(str());
+    }
+    //! the postponed message if it is the only content, nullptr otherwise
+    const deferred_message* deferred() {
+        return pending.format && sb.str().empty() ? &pending : nullptr;
+    }
+    //! the collected message, formats a postponed message if needed
+    std::string& str() {
+        if (pending.format) {
+            if (sb.str().empty())
+                pending.format_to(sb.str());
+            else {
+                std::string head;
+                pending.format_to(head);
+                sb.str().insert(0, head);
+            }
+            pending.format = nullptr;
+        }
+        return sb.str();
+    }
+
+private:
+    log_buffer sb;
+    deferred_message pending;
+};
+/**
+ * @fn log_stream& operator<<(log_stream&, const deferred_message&)
+ * @brief add a postponed FMT message to the log stream
+ *
+ * @param os the log stream
+ * @param msg the message
+ * @return reference to the stream for chaining
+ */
+inline log_stream& operator<<(log_stream& os, const deferred_message& msg) {
+    os.defer(msg);
+    return os;
+}
+/**
+ * @fn std::ostream& operator<<(std::ostream&, const deferred_message&)
+ * @brief format a postponed FMT message into an arbitrary stream
+ *
+ * @param os the output stream
+ * @param msg the message
+ * @return reference to the stream for chaining
+ */
+inline std::ostream& operator<<(std::ostream& os,
+                                const deferred_message& msg) {
+    std::string str;
+    msg.format_to(str);
+    return os << str;
+}
+#ifdef FMT_SHARED
+template <typename... ARGS>
+struct deferrable_args : std::true_type {};
+template <typename T, typename... ARGS>
+struct deferrable_args<T, ARGS...>
+    : std::integral_constant<bool, (std::is_arithmetic<std::decay_t<T>>::value ||
+                                    std::is_enum<std::decay_t<T>>::value) &&
+                                       deferrable_args<ARGS...>::value> {};
+
+template <typename... ARGS>
+struct deferrable_args_size : std::integral_constant<std::size_t, 0> {};
+template <typename T, typename... ARGS>
+struct deferrable_args_size<T, ARGS...>
+    : std::integral_constant<std::size_t,
+                             sizeof(std::decay_t<T>) +
+                                 deferrable_args_size<ARGS...>::value> {};
+/**
+ * @brief true if the arguments of a message can be stored in a
+ * deferred_message
+ */
+template <typename... ARGS>
+using is_deferrable = std::integral_constant<
+    bool, deferrable_args<ARGS...>::value &&
+              deferrable_args_size<ARGS...>::value <=
+                  deferred_message::capacity>;
+
+/**
+ * @brief true for the format strings which stay valid after the statement,
+ * i.e. constant character arrays (string literals) and FMT_STRING()
+ */
+template <typename S>
+struct is_static_format : fmt::detail::is_compile_string<std::decay_t<S>> {};
+template <std::size_t N>
+struct is_static_format<const char (&)[N]> : std::true_type {};
+
+/**
+ * @class log_format_string
+ * @brief the format string of the FMT form of the SCP_ macros
+ *
+ * Like fmt::format_string the format is checked against the arguments at
+ * compile time if the compiler supports consteval or if it is passed as
+ * FMT_STRING(), fmt::runtime() skips the check. It also tells if the format
+ * string may be kept to format the message later.
+ */
+template <typename... ARGS>
+struct log_format_string {
+    template <typename S,
+              std::enable_if_t<
+                  std::is_convertible<const S&, fmt::string_view>::value,
+                  int> = 0>
+    FMT_CONSTEVAL log_format_string(S&& s):
+        str(s), is_static(is_static_format<S>::value) {}
+    template <typename S,
+              std::enable_if_t<
+                  !std::is_convertible<const S&, fmt::string_view>::value &&
+                      std::is_constructible<fmt::format_string<ARGS...>,
+                                            S>::value,
+                  int> = 0>
+    log_format_string(S&& s): str(std::forward<S>(s)) {}
+
+    fmt::format_string<ARGS...> str;
+    bool is_static{ false };
+};
+
+template <typename T>
+inline void store_deferred_arg(unsigned char*& p, const T& v) {
+    std::memcpy(p, &v, sizeof(T));
+    p += sizeof(T);
+}
+
+template <typename T>
+inline auto load_deferred_arg(const unsigned char*& p) -> T {
+    T v;
+    std::memcpy(&v, p, sizeof(T));
+    p += sizeof(T);
+    return v;
+}
+
+template <typename... ARGS, std::size_t... I>
+inline void format_deferred_impl(std::string& out, fmt::string_view fmt,
+                                 const unsigned char* data,
+                                 std::index_sequence<I...>) {
+    // braced initialization guarantees left to right evaluation
+    std::tuple<ARGS...> args{ load_deferred_arg<ARGS>(data)... };
+    (void)data;
+    // the format has been checked when the message was created
+    fmt::format_to(std::back_inserter(out), fmt::runtime(fmt),
+                   std::get<I>(args)...);
+}
+
+template <typename... ARGS>
+void format_deferred(std::string& out, const char* fmt, std::size_t size,
+                     const unsigned char* data) {
+    format_deferred_impl<ARGS...>(out, fmt::string_view(fmt, size), data,
+                                  std::index_sequence_for<ARGS...>{});
+}
+
+//! the index of format_deferred<ARGS...> in the registered format functions
+template <typename... ARGS>
+auto deferred_format_id() -> std::uint32_t {
+    static const auto id = register_deferred_format(&format_deferred<ARGS...>);
+    return id;
+}
+/**
+ * @fn deferred_message make_log_message(log_format_string<ARGS...>,
+ * ARGS&&...)
+ * @brief create the message of the FMT form of the SCP_ macros
+ *
+ * Messages with arithmetic arguments are captured unformatted. Only if the
+ * format string is static they are kept unformatted beyond the statement,
+ * all others are formatted right away.
+ */
+template <typename... ARGS>
+inline auto make_log_message(
+    log_format_string<fmt::type_identity_t<ARGS>...> fmt, ARGS&&... args)
+    -> std::enable_if_t<is_deferrable<ARGS...>::value, deferred_message> {
+    deferred_message msg;
+    msg.format = &format_deferred<std::decay_t<ARGS>...>;
+    if (fmt.is_static)
+        msg.format_id = deferred_format_id<std::decay_t<ARGS>...>();
+    fmt::string_view str = fmt.str;
+    msg.fmt = str.data();
+    msg.fmt_size = str.size();
+    msg.size = deferrable_args_size<ARGS...>::value;
+    auto p = msg.args;
+    int unused[] = { 0, (store_deferred_arg(p, args), 0)... };
+    (void)unused;
+    (void)p;
+    return msg;
+}
+
+template <typename... ARGS>
+inline auto make_log_message(
+    log_format_string<fmt::type_identity_t<ARGS>...> fmt, ARGS&&... args)
+    -> std::enable_if_t<!is_deferrable<ARGS...>::value, std::string> {
+    return fmt::format(fmt.str, std::forward<ARGS>(args)...);
+}
+#endif
+/**
+ * @class log_stream_pool
+ * @brief thread local set of reusable log streams
+ *
+ * Streams are handed out in LIFO order so that a message may be composed
+ * while another one is still being composed (e.g. if an operator<< logs
+ * itself). If the pool is exhausted a stream is allocated on the heap.
+ */
+class log_stream_pool
+{
+public:
+    //! get a cleared stream
+    log_stream& acquire() {
+        if (used < streams.size()) {
+            auto& s = streams[used++];
+            s.reset();
+            return s;
+        }
+        return *new log_stream();
+    }
+    //! return a stream obtained by acquire()
+    void release(log_stream& s) {
+        if (&s >= streams.data() && &s < streams.data() + streams.size())
+            used--;
+        else
+            delete &s;
+    }
+    //! the pool of the calling thread
+    static log_stream_pool& get() {
+        static thread_local log_stream_pool pool;
+        return pool;
+    }
+
+private:
+    std::array<log_stream, 4> streams;
+    std::size_t used{ 0 };
+};
+/**
+ * @fn bool report_direct(sc_core::sc_severity, const char*, const char*, int,
+ * const char*, int)
+ * @brief hand a message directly to the logging outputs
+ *
+ * This is used by ScLogger if direct output is enabled (see
+ * LogConfig::directOutput()). Only SC_INFO messages are handled this way,
+ * their actions are determined and counted as by sc_report_handler::report.
+ * Messages of other severities, messages whose actions require an sc_report
+ * as well as all messages when direct output is disabled are rejected and
+ * need to be reported using sc_report_handler::report.
+ *
+ * @param severity the severity of the message
+ * @param msg_type the message type
+ * @param msg the message text
+ * @param verbosity the verbosity of the message
+ * @param file where the log entry originates
+ * @param line number where the log entry originates
+ * @return true if the message has been handled
+ */
+bool report_direct(sc_core::sc_severity severity, const char* msg_type,
+                   const char* msg, int verbosity, const char* file,
+                   int line);
+/**
+ * @fn bool report_deferred(sc_core::sc_severity, const char*,
+ * const deferred_message&, int, const char*, int)
+ * @brief hand an unformatted message directly to the logging outputs
+ *
+ * This is used by ScLogger if deferred formatting is enabled (see
+ * LogConfig::deferredFormatting()). The message is formatted by the logging
+ * thread. Like report_direct() only SC_INFO messages are handled.
+ *
+ * @param severity the severity of the message
+ * @param msg_type the message type
+ * @param msg the unformatted message
+ * @param verbosity the verbosity of the message
+ * @param file where the log entry originates
+ * @param line number where the log entry originates
+ * @return true if the message has been handled
+ */
+bool report_deferred(sc_core::sc_severity severity, const char* msg_type,
+                     const deferred_message& msg, int verbosity,
+                     const char* file, int line);
+/**
+ * @fn bool rate_limit_passed(sc_core::sc_severity, const char*, int,
+ * const char*, int)
+ * @brief apply the rate limit (see LogConfig::rateLimit()) to a message of
+ * an SCP_ report macro before the message is composed
+ *
+ * @param severity the severity of the message
+ * @param msg_type the message type
+ * @param verbosity the verbosity of the message
+ * @param file where the log entry originates
+ * @param line number where the log entry originates
+ * @return false if the message shall be suppressed
+ */
+bool rate_limit_passed(sc_core::sc_severity severity, const char* msg_type,
+                       int verbosity, const char* file, int line);
+/**
+ * @struct rate_limit_check
+ * @brief calls rate_limit_passed() with the message type given like to
+ * ScLogger::type()
+ */
+struct rate_limit_check {
+    sc_core::sc_severity severity;
+    int verbosity;
+    const char* file;
+    int line;
+
+    bool type() const { return type(static_cast<const char*>(nullptr)); }
+    bool type(char const* t) const {
+        return rate_limit_passed(severity, t ? t : "SystemC", verbosity, file,
+                                 line);
+    }
+    bool type(std::string const& t) const { return type(t.c_str()); }
+};
 /**
  * @struct ScLogger
  * @brief the logger class
@@ -386,7 +1206,11 @@ struct ScLogger {
      * @param verbosity the log level
      */
     ScLogger(const char* file, int line, int verbosity = sc_core::SC_MEDIUM):
-        t(nullptr), file(file), line(line), level(verbosity){};
+        os(log_stream_pool::get().acquire()),
+        t(nullptr),
+        file(file),
+        line(line),
+        level(verbosity){};
 
     ScLogger() = delete;
 
@@ -403,8 +1227,16 @@ struct ScLogger {
      *
      */
     virtual ~ScLogger() {
-        ::sc_core::sc_report_handler::report(
-            SEVERITY, t ? t : "SystemC", os.str().c_str(), level, file, line);
+        auto type = t ? t : "SystemC";
+        auto deferred = os.deferred();
+        if (!deferred ||
+            !report_deferred(SEVERITY, type, *deferred, level, file, line)) {
+            auto msg = os.str().c_str();
+            if (!report_direct(SEVERITY, type, msg, level, file, line))
+                ::sc_core::sc_report_handler::report(SEVERITY, type, msg,
+                                                     level, file, line);
+        }
+        log_stream_pool::get().release(os);
     }
     /**
      * @fn ScLogger& type()
@@ -439,15 +1271,15 @@ struct ScLogger {
         return *this;
     }
     /**
-     * @fn std::ostream& get()
-     * @brief  get the underlying ostringstream
+     * @fn log_stream& get()
+     * @brief  get the underlying output stream
      *
      * @return the output stream collecting the log message
      */
-    inline std::ostream& get() { return os; };
+    inline log_stream& get() { return os; };
 
 protected:
-    std::ostringstream os{};
+    log_stream& os;
     char* t{ nullptr };
     const char* file;
     const int line;
@@ -489,16 +1321,37 @@ protected:
 
 /* User interface macros */
 #define SCMOD this->sc_core::sc_module::name()
-#define SCP_LOGGER(...)                                                 \
-    scp::scp_logger_cache IIF(IS_PAREN(FIRST_ARG(__VA_ARGS__)))(        \
-        SCP_LOGGER_NAME(EXPAND(FIRST_ARG FIRST_ARG(__VA_ARGS__))),      \
-        SCP_LOGGER_NAME()) = { sc_core::SC_UNSET,                       \
-                               "",                                      \
-                               { IIF(IS_PAREN(FIRST_ARG(__VA_ARGS__)))( \
-                                   POP_ARG(__VA_ARGS__), ##__VA_ARGS__) } }
-
-#define SCP_LOGGER_VECTOR(NAME) \
-    std::vector<scp::scp_logger_cache> SCP_LOGGER_NAME(NAME)
+/* the name of the logger cache declared by SCP_LOGGER(...) */
+#define SCP_LOGGER_VAR(...)                                           \
+    IIF(IS_PAREN(FIRST_ARG(__VA_ARGS__)))                             \
+    (SCP_LOGGER_NAME(EXPAND(FIRST_ARG FIRST_ARG(__VA_ARGS__))),       \
+     SCP_LOGGER_NAME())
+/* registers the statements for the resolution at end of elaboration */
+#define SCP_LOGGER_REGISTRATION(var, ...)                             \
+    scp::scp_logger_registration CAT(var, _registration) {            \
+        [this](scp::logger_resolution& batch) { __VA_ARGS__ }         \
+    }
+
+#define SCP_LOGGER(...)                                               \
+    scp::scp_logger_cache SCP_LOGGER_VAR(__VA_ARGS__) = {             \
+        sc_core::SC_UNSET,                                            \
+        "",                                                           \
+        { IIF(IS_PAREN(FIRST_ARG(__VA_ARGS__)))(POP_ARG(__VA_ARGS__), \
+                                                ##__VA_ARGS__) }      \
+    };                                                                \
+    SCP_LOGGER_REGISTRATION(SCP_LOGGER_VAR(__VA_ARGS__),              \
+                            scp::resolve_logger(                      \
+                                batch, SCP_LOGGER_VAR(__VA_ARGS__),   \
+                                scp::call_sc_name_fn()(this),         \
+                                typeid(*this).name());)
+
+#define SCP_LOGGER_VECTOR(NAME)                                       \
+    std::vector<scp::scp_logger_cache> SCP_LOGGER_NAME(NAME);         \
+    SCP_LOGGER_REGISTRATION(                                          \
+        SCP_LOGGER_NAME(NAME),                                        \
+        for (auto& c : SCP_LOGGER_NAME(NAME)) scp::resolve_logger(    \
+            batch, c, scp::call_sc_name_fn()(this),                   \
+            typeid(*this).name());)
 #define SCP_LOGGER_VECTOR_PUSH_BACK(NAME, ...) \
     SCP_LOGGER_NAME(NAME).push_back(           \
         { sc_core::SC_UNSET, "", { __VA_ARGS__ } });
@@ -536,13 +1389,34 @@ public:
 // or a cache'd level
 
 /*** Helper macros for SCP_ report macros ****/
-#define SCP_VBSTY_CHECK_CACHED(lvl, features, cached, ...)             \
-    (cached.level >= lvl) &&                                           \
-        (cached.get_log_verbosity_cached(scp::call_sc_name_fn()(this), \
-                                         typeid(*this).name()) >= lvl)
+/* the least severe level (as scp::log value) the SCP_ report macros are
+ * compiled for. Macros of less severe levels expand to a dead branch which
+ * still type-checks the arguments. SCP_ERR and SCP_FATAL are always
+ * compiled. */
+#ifndef SCP_COMPILED_LOG_LEVEL
+#define SCP_COMPILED_LOG_LEVEL 7 // scp::log::TRACEALL
+#endif
+/* lvl is the numeric scp::log value as level names like DEBUG are often
+ * defined as macros themselves */
+#define SCP_LEVEL_COMPILED(lvl) (SCP_COMPILED_LOG_LEVEL >= lvl)
+
+#define SCP_VBSTY_CHECK_CACHED(lvl, features, cached, ...)                   \
+    ((cached.epoch == ::scp::log_level_epoch.load(std::memory_order_relaxed) \
+          ? cached.gate                                                      \
+          : (cached.get_log_verbosity_cached(scp::call_sc_name_fn()(this),   \
+                                             typeid(*this).name()),          \
+             cached.gate)) >= lvl                                            \
+         ? ::scp::log_or_record(cached.level, lvl)                           \
+         : ::scp::log_check::SKIP)
+
+#define SCP_VBSTY_SITE()                   \
+    []() -> ::scp::verbosity_site& {       \
+        static ::scp::verbosity_site site; \
+        return site;                       \
+    }()
 
 #define SCP_VBSTY_CHECK_UNCACHED(lvl, ...) \
-    (::scp::get_log_verbosity(__VA_ARGS__) >= lvl)
+    SCP_VBSTY_SITE().check<lvl>(__VA_ARGS__)
 
 #define SCP_VBSTY_CHECK(lvl, ...)                                    \
     IIF(IS_PAREN(FIRST_ARG(__VA_ARGS__)))                            \
@@ -559,11 +1433,20 @@ public:
      __VA_ARGS__)
 
 #ifdef FMT_SHARED
-#define _SCP_FMT_EMPTY_STR(...) fmt::format(__VA_ARGS__)
+#define _SCP_FMT_EMPTY_STR(...) ::scp::make_log_message(__VA_ARGS__)
 #else
 #define _SCP_FMT_EMPTY_STR(...) "Please add FMT library for FMT support."
 #endif
 
+/* the rate limit is checked before a message within the level of its logger
+ * is composed, a message only taken by the flight recorder is composed
+ * without */
+#define SCP_RATE_CHECK(check, sev, lvl, ...)                              \
+    ::scp::log_check_passed(check, [&]() {                                \
+        return ::scp::rate_limit_check{ sev, lvl, __FILE__, __LINE__ }    \
+            .type(SCP_GET_FEATURES(__VA_ARGS__));                         \
+    })
+
 #define SCP_LOG(lvl, ...)                                             \
     ::scp::ScLogger<::sc_core::SC_INFO>(__FILE__, __LINE__, lvl / 10) \
             .type(SCP_GET_FEATURES(__VA_ARGS__))                      \
@@ -572,28 +1455,43 @@ public:
 /*** End HELPER Macros *******/
 
 //! macro for debug trace level output
-#define SCP_TRACEALL(...)                                  \
-    if (SCP_VBSTY_CHECK(sc_core::SC_DEBUG, ##__VA_ARGS__)) \
+#define SCP_TRACEALL(...)                                              \
+    if (SCP_LEVEL_COMPILED(7) &&                                       \
+        SCP_RATE_CHECK(                                                \
+            SCP_VBSTY_CHECK(sc_core::SC_DEBUG, ##__VA_ARGS__),         \
+            sc_core::SC_INFO, sc_core::SC_DEBUG / 10, __VA_ARGS__))    \
     SCP_LOG(sc_core::SC_DEBUG, __VA_ARGS__)
 //! macro for trace level output
-#define SCP_TRACE(...)                                    \
-    if (SCP_VBSTY_CHECK(sc_core::SC_FULL, ##__VA_ARGS__)) \
+#define SCP_TRACE(...)                                                 \
+    if (SCP_LEVEL_COMPILED(6) &&                                       \
+        SCP_RATE_CHECK(                                                \
+            SCP_VBSTY_CHECK(sc_core::SC_FULL, ##__VA_ARGS__),          \
+            sc_core::SC_INFO, sc_core::SC_FULL / 10, __VA_ARGS__))     \
     SCP_LOG(sc_core::SC_FULL, __VA_ARGS__)
 //! macro for debug level output
-#define SCP_DEBUG(...)                                    \
-    if (SCP_VBSTY_CHECK(sc_core::SC_HIGH, ##__VA_ARGS__)) \
+#define SCP_DEBUG(...)                                                 \
+    if (SCP_LEVEL_COMPILED(5) &&                                       \
+        SCP_RATE_CHECK(                                                \
+            SCP_VBSTY_CHECK(sc_core::SC_HIGH, ##__VA_ARGS__),          \
+            sc_core::SC_INFO, sc_core::SC_HIGH / 10, __VA_ARGS__))     \
     SCP_LOG(sc_core::SC_HIGH, __VA_ARGS__)
 //! macro for info level output
-#define SCP_INFO(...)                                       \
-    if (SCP_VBSTY_CHECK(sc_core::SC_MEDIUM, ##__VA_ARGS__)) \
+#define SCP_INFO(...)                                                  \
+    if (SCP_LEVEL_COMPILED(4) &&                                       \
+        SCP_RATE_CHECK(                                                \
+            SCP_VBSTY_CHECK(sc_core::SC_MEDIUM, ##__VA_ARGS__),        \
+            sc_core::SC_INFO, sc_core::SC_MEDIUM / 10, __VA_ARGS__))   \
     SCP_LOG(sc_core::SC_MEDIUM, __VA_ARGS__)
 //! macro for warning level output
-#define SCP_WARN(...)                                          \
-    if (SCP_VBSTY_CHECK(sc_core::SC_LOW, ##__VA_ARGS__))       \
-    ::scp::ScLogger<::sc_core::SC_WARNING>(__FILE__, __LINE__, \
-                                           sc_core::SC_MEDIUM) \
-            .type(SCP_GET_FEATURES(__VA_ARGS__))               \
-            .get()                                             \
+#define SCP_WARN(...)                                                  \
+    if (SCP_LEVEL_COMPILED(3) &&                                       \
+        SCP_RATE_CHECK(                                                \
+            SCP_VBSTY_CHECK(sc_core::SC_LOW, ##__VA_ARGS__),           \
+            sc_core::SC_WARNING, sc_core::SC_MEDIUM, __VA_ARGS__))     \
+    ::scp::ScLogger<::sc_core::SC_WARNING>(__FILE__, __LINE__,         \
+                                           sc_core::SC_MEDIUM)         \
+            .type(SCP_GET_FEATURES(__VA_ARGS__))                       \
+            .get()                                                     \
         << _SCP_FMT_EMPTY_STR
 //! macro for error level output
 #define SCP_ERR(...)                                         \
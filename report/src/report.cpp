@@ -21,21 +21,35 @@
  */
 
 #include <scp/report.h>
+#include <algorithm>
 #include <array>
+#include <atomic>
+#include <cctype>
 #include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
 #include <fstream>
+#include <iterator>
+#include <limits>
+#include <map>
+#include <memory>
+#include <set>
 #include <systemc>
 #ifdef HAS_CCI
 #include <cci_configuration>
 #endif
 #include <mutex>
 #include <spdlog/async.h>
+#include <spdlog/pattern_formatter.h>
 #include <spdlog/sinks/basic_file_sink.h>
 #include <spdlog/sinks/stdout_color_sinks.h>
 #include <spdlog/spdlog.h>
 #include <thread>
 #include <tuple>
 #include <unordered_map>
+#include <unordered_set>
+#include <vector>
 #if defined(__GNUC__) || defined(__clang__)
 #define likely(x)   __builtin_expect(x, 1)
 #define unlikely(x) __builtin_expect(x, 0)
@@ -45,37 +59,479 @@
 #endif
 
 #include <regex>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
 #ifdef ERROR
 #undef ERROR
 #endif
 
 namespace {
-// Making this thread_local could cause thread copies of the same cache
-// entries, but more likely naming will be thread local too, and this avoids
-// races in the unordered_map
+/* process wide map from the hash of a message type to its verbosity.
+ * Readers never lock, they probe the published table using open addressing
+ * and check the key again after reading the value as the slot may be
+ * cleared and reused meanwhile. Writers serialize on a mutex. Clearing
+ * empties the table in place, growing publishes a new table. As readers may
+ * still use an old table at any time, the old tables are only freed with
+ * the table. Since the size doubles they take less than the current one */
+class verbosity_table
+{
+public:
+    verbosity_table(): current(new table(initial_size)) {}
+    ~verbosity_table() { delete current.load(std::memory_order_relaxed); }
+
+    auto find(uint64_t key, sc_core::sc_verbosity& verbosity) const -> bool {
+        key = key ? key : 1;
+        auto t = current.load(std::memory_order_acquire);
+        for (auto i = index(key, t->mask);; i = (i + 1) & t->mask) {
+            auto& s = t->slots[i];
+            auto k = s.key.load(std::memory_order_acquire);
+            if (k == key) {
+                auto v = s.value.load(std::memory_order_acquire);
+                if (s.key.load(std::memory_order_relaxed) != key)
+                    return false;
+                verbosity = static_cast<sc_core::sc_verbosity>(v);
+                return true;
+            }
+            if (!k)
+                return false;
+        }
+    }
 
-#ifdef DISABLE_REPORT_THREAD_LOCAL
-std::unordered_map<uint64_t, sc_core::sc_verbosity> lut;
-#else
-thread_local std::unordered_map<uint64_t, sc_core::sc_verbosity> lut;
-#endif
+    /* adds a verbosity resolved in the given log level epoch. It is dropped
+     * if the table has been cleared since as the value may be stale */
+    void insert(uint64_t key, sc_core::sc_verbosity verbosity,
+                uint32_t epoch) {
+        key = key ? key : 1;
+        std::lock_guard<std::mutex> lock(guard);
+        if (epoch != scp::log_level_epoch.load(std::memory_order_relaxed))
+            return;
+        auto t = current.load(std::memory_order_relaxed);
+        if ((t->used + 1) * 2 > t->mask + 1)
+            t = grow(t);
+        put(*t, key, verbosity);
+    }
+
+    // invalidates all entries for all threads at once and starts a new log
+    // level epoch
+    void clear() {
+        std::lock_guard<std::mutex> lock(guard);
+        auto t = current.load(std::memory_order_relaxed);
+        for (size_t i = 0; i <= t->mask; ++i)
+            t->slots[i].key.store(0, std::memory_order_relaxed);
+        t->used = 0;
+        scp::log_level_epoch.fetch_add(1, std::memory_order_release);
+    }
+
+private:
+    static constexpr size_t initial_size = 64;
+
+    struct slot {
+        std::atomic<uint64_t> key{ 0 }; // 0 marks an empty slot
+        std::atomic<int> value{ 0 };
+    };
+    struct table {
+        explicit table(size_t size): mask(size - 1), slots(new slot[size]) {}
+        size_t mask;
+        size_t used{ 0 };
+        std::unique_ptr<slot[]> slots;
+    };
+    static auto index(uint64_t key, size_t mask) -> size_t {
+        return (key * 0x9E3779B97F4A7C15ULL >> 32) & mask;
+    }
+
+    static void put(table& t, uint64_t key, int value) {
+        auto i = index(key, t.mask);
+        for (; t.slots[i].key.load(std::memory_order_relaxed);
+             i = (i + 1) & t.mask) {
+            if (t.slots[i].key.load(std::memory_order_relaxed) == key) {
+                t.slots[i].value.store(value, std::memory_order_release);
+                return;
+            }
+        }
+        // the release orders a preceding clear of the slot before the value
+        t.slots[i].value.store(value, std::memory_order_release);
+        t.slots[i].key.store(key, std::memory_order_release);
+        ++t.used;
+    }
+
+    auto grow(table* from) -> table* {
+        auto t = new table((from->mask + 1) * 2);
+        for (size_t i = 0; i <= from->mask; ++i)
+            if (auto k = from->slots[i].key.load(std::memory_order_relaxed))
+                put(*t, k,
+                    from->slots[i].value.load(std::memory_order_relaxed));
+        current.store(t, std::memory_order_release);
+        retired.emplace_back(from);
+        return t;
+    }
+
+    std::atomic<table*> current;
+    std::mutex guard;
+    std::vector<std::unique_ptr<table>> retired;
+};
+
+auto verbosity_lut() -> verbosity_table& {
+    static verbosity_table lut;
+    return lut;
+}
+
+/* drops all cached verbosities. The call site caches of the SCP_ macros
+ * notice the new epoch on their next use */
+void invalidate_log_verbosity() { verbosity_lut().clear(); }
 
 #ifdef HAS_CCI
 cci::cci_originator scp_global_originator("scp_reporting_global");
 #endif
 
+// guards the data below and the log level indices of the brokers
+std::mutex index_guard;
 std::set<std::string> logging_parameters;
+// log level parameters with a callback invalidating the cached verbosities
+std::set<std::string> watched_parameters;
+/* a resolved logger, the names of its parameters are added to
+ * logging_parameters when they are requested */
+struct logging_request {
+    std::string scname;
+    std::vector<std::string> features;
+    std::string type_name;
+
+    auto operator<(const logging_request& o) const -> bool {
+        return std::tie(scname, features, type_name) <
+               std::tie(o.scname, o.features, o.type_name);
+    }
+};
+std::set<logging_request> logging_requests;
 
-struct ExtLogConfig : public scp::LogConfig {
-    std::shared_ptr<spdlog::logger> file_logger;
-    std::shared_ptr<spdlog::logger> console_logger;
+// BKDR hash algorithm
+auto char_hash(char const* str) -> uint64_t {
+    constexpr unsigned int seed = 131; // 31  131 1313 13131131313 etc//
+    uint64_t hash = 0;
+    while (*str) {
+        hash = (hash * seed) + (*str);
+        str++;
+    }
+    return hash;
+}
+
+inline auto to_lower(char c) -> char {
+    return static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+}
+
+/* decides if a message type passes the log filter regex. Message types come
+ * from a small set so the decision is cached per type. Patterns consisting
+ * of literal text and '.*', optionally anchored by '^' and '$', are matched
+ * without std::regex */
+/* guards the caches of log_cfg which are written while messages are
+ * reported. They are only shared by threads if log_cfg is (see
+ * DISABLE_REPORT_THREAD_LOCAL), otherwise the lock does nothing */
+#ifdef DISABLE_REPORT_THREAD_LOCAL
+struct cache_mutex : std::mutex {
+    cache_mutex() = default;
+    // the owner may be copied while configuring, the copy gets its own lock
+    cache_mutex(const cache_mutex&) {}
+    auto operator=(const cache_mutex&) -> cache_mutex& { return *this; }
+};
+#else
+struct cache_mutex {
+    void lock() {}
+    void unlock() {}
+};
+#endif
+
+class type_filter
+{
+public:
+    void set(const std::string& pattern) {
+        std::lock_guard<cache_mutex> lock(guard);
+        decisions.clear();
+        simple = parse(pattern);
+        if (!simple)
+            reg_ex = std::regex(pattern,
+                                std::regex::extended | std::regex::icase);
+    }
+
+    auto match(const char* type) -> bool {
+        auto key = char_hash(type);
+        std::lock_guard<cache_mutex> lock(guard);
+        auto it = decisions.find(key);
+        if (likely(it != decisions.end() && it->second.type == type))
+            return it->second.match;
+        auto m = simple ? match_simple(type) : regex_search(type, reg_ex);
+        if (decisions.size() < max_decisions)
+            decisions[key] = { type, m };
+        return m;
+    }
+
+private:
+    struct decision {
+        std::string type;
+        bool match;
+    };
+    // bounds the cache if message types are built at runtime
+    static constexpr size_t max_decisions = 4096;
+
+    auto parse(const std::string& pattern) -> bool {
+        segments.assign(1, std::string());
+        anchored_begin = anchored_end = false;
+        for (size_t i = 0; i < pattern.size(); ++i) {
+            auto c = pattern[i];
+            switch (c) {
+            case '^':
+                if (i != 0)
+                    return false;
+                anchored_begin = true;
+                break;
+            case '$':
+                if (i != pattern.size() - 1)
+                    return false;
+                anchored_end = true;
+                break;
+            case '.':
+                if (i + 1 == pattern.size() || pattern[i + 1] != '*')
+                    return false;
+                segments.emplace_back();
+                ++i;
+                break;
+            case '\\':
+                if (++i == pattern.size() ||
+                    !std::strchr(".[]()*+?{}|^$\\", pattern[i]))
+                    return false;
+                segments.back() += to_lower(pattern[i]);
+                break;
+            case '[':
+            case ']':
+            case '(':
+            case ')':
+            case '*':
+            case '+':
+            case '?':
+            case '{':
+            case '}':
+            case '|':
+                return false;
+            default:
+                segments.back() += to_lower(c);
+            }
+        }
+        return true;
+    }
+
+    static auto equals(const char* str, const std::string& seg) -> bool {
+        for (auto c : seg)
+            if (to_lower(*str++) != c)
+                return false;
+        return true;
+    }
+
+    static auto find(const char* begin, const char* end,
+                     const std::string& seg) -> const char* {
+        for (; begin + seg.size() <= end; ++begin)
+            if (equals(begin, seg))
+                return begin;
+        return nullptr;
+    }
+
+    auto match_simple(const char* type) const -> bool {
+        const char* begin = type;
+        const char* end = type + std::strlen(type);
+        const char* pos = begin;
+        for (size_t i = 0; i < segments.size(); ++i) {
+            const auto& seg = segments[i];
+            if (i + 1 == segments.size() && anchored_end) {
+                if (i == 0 && anchored_begin)
+                    return size_t(end - begin) == seg.size() &&
+                           equals(begin, seg);
+                return size_t(end - pos) >= seg.size() &&
+                       equals(end - seg.size(), seg);
+            }
+            if (i == 0 && anchored_begin) {
+                if (size_t(end - begin) < seg.size() || !equals(begin, seg))
+                    return false;
+            } else if (!(pos = find(pos, end, seg)))
+                return false;
+            pos += seg.size();
+        }
+        return true;
+    }
+
+    bool simple{ false };
+    bool anchored_begin{ false };
+    bool anchored_end{ false };
+    std::vector<std::string> segments;
     std::regex reg_ex;
+    std::unordered_map<uint64_t, decision> decisions;
+    cache_mutex guard;
+};
+
+/* sink counting the processed flushes of its logger. All flushes are
+ * requested through it so that waiting for the count to reach the number of
+ * requests waits until all messages logged before are written, also if the
+ * logger is asynchronous. It is the last sink of the logger and does not
+ * write messages */
+class drain_sink : public spdlog::sinks::sink
+{
+public:
+    drain_sink() { set_level(spdlog::level::off); }
+
+    void log(const spdlog::details::log_msg&) override {}
+    void set_pattern(const std::string&) override {}
+    void set_formatter(std::unique_ptr<spdlog::formatter>) override {}
+
+    void flush() override {
+        std::lock_guard<std::mutex> lock(mtx);
+        ++done;
+        cond.notify_all();
+    }
+
+    //! count a flush which is about to be requested from the logger
+    void request() { ++requested; }
+
+    //! wait until all requested flushes have been processed
+    void wait() {
+        auto target = requested.load();
+        std::unique_lock<std::mutex> lock(mtx);
+        cond.wait(lock, [this, target] { return done >= target; });
+    }
+
+    //! as wait() but gives up after timeout. A flush discarded by the queue
+    //! of the logger is then taken as processed, so that later waits do not
+    //! time out as well
+    void wait_for(std::chrono::milliseconds timeout) {
+        auto target = requested.load();
+        std::unique_lock<std::mutex> lock(mtx);
+        if (!cond.wait_for(lock, timeout,
+                           [this, target] { return done >= target; }))
+            done = target;
+    }
+
+private:
+    std::atomic<uint64_t> requested{ 0 };
+    uint64_t done{ 0 };
+    std::mutex mtx;
+    std::condition_variable cond;
+};
+
+/* an output of the logging, i.e. a scp::LogSink with its settings resolved
+ * when the logging is configured */
+struct output {
+    std::shared_ptr<spdlog::logger> logger;
+    std::shared_ptr<drain_sink> drain;
+    //! the settings used to compose the messages
+    scp::LogConfig cfg;
+    type_filter filter;
+    //! the least severe level written
+    scp::log level;
+    //! written for the SC_LOG action, else for SC_DISPLAY
+    bool file;
+};
+
+/* counts the messages per call site or message type to limit their number
+ * (see scp::LogConfig::rateLimit()) */
+class rate_limiter
+{
+public:
+    struct state {
+        std::string type;
+        std::string file;
+        int line;
+        sc_core::sc_severity severity;
+        int verbosity;
+        sc_core::sc_time::value_type window_start;
+        unsigned count;
+        uint64_t suppressed;
+    };
+
+    /* returns true if the message shall be suppressed. The states of all
+     * keys whose window ended with suppressed messages are passed to
+     * summary first, whatever the key of the message */
+    template <typename REPORT, typename SUMMARY>
+    auto check(const REPORT& rep, const scp::LogConfig& cfg,
+               sc_core::sc_time::value_type now, SUMMARY&& summary) -> bool {
+        std::lock_guard<cache_mutex> lock(guard);
+        auto window = cfg.rate_limit_window.value();
+        if (unlikely(now >= next_flush))
+            flush(now, window, summary);
+        auto type = rep.get_msg_type();
+        auto file = rep.get_file_name() ? rep.get_file_name() : "";
+        auto line = rep.get_line_number();
+        auto key = cfg.rate_limit_by_type
+                       ? char_hash(type)
+                       : char_hash(file) * 31 + static_cast<unsigned>(line);
+        auto it = states.find(key);
+        if (unlikely(it == states.end() ||
+                     (cfg.rate_limit_by_type ? it->second.type != type
+                                             : it->second.line != line ||
+                                                   it->second.file != file))) {
+            // a new key, a hash collision replaces the old state
+            if (it != states.end() && it->second.suppressed)
+                summary(it->second);
+            states[key] = { type, file, line, rep.get_severity(),
+                            rep.get_verbosity(), now, 1, 0 };
+            return false;
+        }
+        auto& st = it->second;
+        if (window && now - st.window_start >= window) {
+            st.window_start = now;
+            st.count = 0;
+        }
+        if (++st.count <= cfg.rate_limit)
+            return false;
+        st.severity = rep.get_severity();
+        st.verbosity = rep.get_verbosity();
+        if (!st.suppressed++ && window)
+            next_flush = std::min(next_flush, st.window_start + window);
+        return true;
+    }
+
+    template <typename FUNC> void for_each(FUNC f) {
+        std::lock_guard<cache_mutex> lock(guard);
+        for (auto& e : states)
+            f(e.second);
+    }
+
+    void clear() {
+        std::lock_guard<cache_mutex> lock(guard);
+        states.clear();
+        next_flush = std::numeric_limits<sc_core::sc_time::value_type>::max();
+    }
+
+private:
+    /* passes the states whose window ended with suppressed messages to
+     * summary, which resets their count */
+    template <typename SUMMARY>
+    void flush(sc_core::sc_time::value_type now,
+               sc_core::sc_time::value_type window, SUMMARY& summary) {
+        next_flush = std::numeric_limits<sc_core::sc_time::value_type>::max();
+        for (auto& e : states) {
+            auto& st = e.second;
+            if (!st.suppressed)
+                continue;
+            if (now - st.window_start >= window)
+                summary(st);
+            else
+                next_flush = std::min(next_flush, st.window_start + window);
+        }
+    }
+
+    std::unordered_map<uint64_t, state> states;
+    //! the earliest end of a window with suppressed messages
+    sc_core::sc_time::value_type next_flush{
+        std::numeric_limits<sc_core::sc_time::value_type>::max()
+    };
+    cache_mutex guard;
+};
+
+struct ExtLogConfig : public scp::LogConfig {
+    std::vector<output> outputs;
+    rate_limiter limiter;
     sc_core::sc_time cycle_base{ 0, sc_core::SC_NS };
     auto operator=(const scp::LogConfig& o) -> ExtLogConfig& {
         scp::LogConfig::operator=(o);
         return *this;
     }
-    auto match(const char* type) -> bool { return regex_search(type, reg_ex); }
 };
 
 /* normally put the config in thread local. If two threads try to use logging
@@ -88,33 +544,69 @@ ExtLogConfig log_cfg;
 thread_local ExtLogConfig log_cfg;
 #endif
 
-inline std::string padded(std::string str, size_t width,
+using buffer_t = spdlog::memory_buf_t;
+
+inline void append(buffer_t& buf, const char* str, size_t len) {
+    buf.append(str, str + len);
+}
+
+inline void append(buffer_t& buf, const char* str) {
+    append(buf, str, std::strlen(str));
+}
+
+template <typename BUFFER>
+inline void append_fill(BUFFER& buf, char c, size_t count) {
+    for (; count; --count)
+        buf.push_back(c);
+}
+
+template <typename BUFFER>
+inline void append_uint(BUFFER& buf, uint64_t val, size_t width = 0,
+                        char fill = ' ') {
+    fmt::format_int str(val);
+    for (auto i = str.size(); i < width; ++i)
+        buf.push_back(fill);
+    buf.append(str.data(), str.data() + str.size());
+}
+
+inline void append_padded(buffer_t& buf, const char* str, size_t width,
                           bool show_ellipsis = true) {
-    if (width < 7)
-        return str;
-    if (str.length() > width) {
+    auto len = std::strlen(str);
+    if (width < 7) {
+        append(buf, str, len);
+    } else if (len > width) {
         if (show_ellipsis) {
-            auto pos = str.size() - (width - 6);
-            return str.substr(0, 3) + "..." +
-                   str.substr(pos, str.size() - pos);
+            append(buf, str, 3);
+            append(buf, "...", 3);
+            append(buf, str + len - (width - 6), width - 6);
         } else
-            return str.substr(0, width);
+            append(buf, str, width);
     } else {
-        return str + std::string(width - str.size(), ' ');
+        append(buf, str, len);
+        append_fill(buf, ' ', width - len);
     }
 }
 
-auto get_tuple(const sc_core::sc_time& t)
-    -> std::tuple<sc_core::sc_time::value_type, sc_core::sc_time_unit> {
-    auto val = t.value();
-    auto tr = (uint64_t)(sc_core::sc_time::from_value(1).to_seconds() * 1E15);
-    auto scale = 0U;
-    while ((tr % 10) == 0) {
-        tr /= 10;
-        scale++;
-    }
-    sc_assert(tr == 1);
+/* the time resolution as power of 10 of a femtosecond. Times other than 0
+ * only show up once the simulation runs and the resolution cannot change
+ * anymore, hence it is computed only once */
+auto time_resolution_scale() -> unsigned {
+    static const unsigned scale = [] {
+        auto tr =
+            (uint64_t)(sc_core::sc_time::from_value(1).to_seconds() * 1E15);
+        auto scale = 0U;
+        while ((tr % 10) == 0) {
+            tr /= 10;
+            scale++;
+        }
+        sc_assert(tr == 1);
+        return scale;
+    }();
+    return scale;
+}
 
+auto get_tuple(sc_core::sc_time::value_type val, unsigned scale)
+    -> std::tuple<sc_core::sc_time::value_type, sc_core::sc_time_unit> {
     auto tu = scale / 3;
     while (tu < sc_core::SC_SEC && (val % 10) == 0) {
         val /= 10;
@@ -126,7 +618,11 @@ auto get_tuple(const sc_core::sc_time& t)
     return std::make_tuple(val, static_cast<sc_core::sc_time_unit>(tu));
 }
 
-auto time2string(const sc_core::sc_time& t) -> std::string {
+/* appends the time right aligned in a field of the given width, scale is
+ * the time resolution (see time_resolution_scale()) */
+template <typename BUFFER>
+void append_time(BUFFER& buf, sc_core::sc_time::value_type value,
+                 size_t width, unsigned scale) {
     const std::array<const char*, 6> time_units{ "fs", "ps", "ns",
                                                  "us", "ms", "s " };
     const std::array<uint64_t, 6> multiplier{ 1ULL,
@@ -136,126 +632,1272 @@ auto time2string(const sc_core::sc_time& t) -> std::string {
                                               1000ULL * 1000 * 1000 * 1000,
                                               1000ULL * 1000 * 1000 * 1000 *
                                                   1000 };
-    std::ostringstream oss;
-    if (!t.value()) {
-        oss << "0 s ";
+    fmt::basic_memory_buffer<char, 64> str;
+    if (!value) {
+        str.append(fmt::string_view("0 s "));
     } else {
-        const auto tt = get_tuple(t);
+        const auto tt = get_tuple(value, scale);
         const auto val = std::get<0>(tt);
         const auto scale = std::get<1>(tt);
         const auto fs_val = val * multiplier[scale];
         for (int j = multiplier.size() - 1; j >= scale; --j) {
             if (fs_val >= multiplier[j]) {
-                const auto i = val / multiplier[j - scale];
-                const auto f = val % multiplier[j - scale];
-                oss << i << '.' << std::setw(3 * (j - scale))
-                    << std::setfill('0') << std::right << f << ' '
-                    << time_units[j];
+                append_uint(str, val / multiplier[j - scale]);
+                str.push_back('.');
+                append_uint(str, val % multiplier[j - scale],
+                            3 * (j - scale), '0');
+                str.push_back(' ');
+                str.append(fmt::string_view(time_units[j]));
                 break;
             }
         }
     }
-    return oss.str();
-}
-auto compose_message(const sc_core::sc_report& rep, const scp::LogConfig& cfg)
-    -> const std::string {
-    if (rep.get_severity() > sc_core::SC_INFO ||
-        cfg.log_filter_regex.length() == 0 ||
-        rep.get_verbosity() == sc_core::SC_MEDIUM ||
-        log_cfg.match(rep.get_msg_type())) {
-        std::stringstream os;
-        if (likely(cfg.print_sim_time)) {
-            if (unlikely(log_cfg.cycle_base.value())) {
-                if (unlikely(cfg.print_delta))
-                    os << "[" << std::setw(7) << std::setfill(' ')
-                       << sc_core::sc_time_stamp().value() /
-                              log_cfg.cycle_base.value()
-                       << "(" << std::setw(5) << sc_core::sc_delta_count()
-                       << ")]";
-                else
-                    os << "[" << std::setw(7) << std::setfill(' ')
-                       << sc_core::sc_time_stamp().value() /
-                              log_cfg.cycle_base.value()
-                       << "]";
-            } else {
-                auto t = time2string(sc_core::sc_time_stamp());
-                if (unlikely(cfg.print_delta))
-                    os << "[" << std::setw(20) << std::setfill(' ') << t << "("
-                       << std::setw(5) << sc_core::sc_delta_count() << ")]";
-                else
-                    os << "[" << std::setw(20) << std::setfill(' ') << t
-                       << "]";
+    if (str.size() < width)
+        append_fill(buf, ' ', width - str.size());
+    buf.append(str.data(), str.data() + str.size());
+}
+
+/* the simulation state a message is composed with. It is captured when the
+ * message is reported as the composition may happen in a different thread */
+struct sim_context {
+    sc_core::sc_time::value_type time;
+    uint64_t delta;
+    sc_core::sc_time::value_type cycle_base;
+    bool running;
+    unsigned scale;
+};
+
+/* the time prefix of a message. Bursts of messages share the same time
+ * stamp and delta cycle so the prefix is only rebuilt if one of them or
+ * the cycle base changes */
+struct time_prefix {
+    sc_core::sc_time::value_type time{ 0 };
+    uint64_t delta{ 0 };
+    sc_core::sc_time::value_type cycle_base{ 0 };
+    unsigned scale{ 0 };
+    bool print_delta{ false };
+    bool valid{ false };
+    fmt::basic_memory_buffer<char, 64> text;
+
+    auto get(const sim_context& ctx, bool with_delta) -> fmt::string_view {
+        if (unlikely(!valid || ctx.time != time ||
+                     ctx.cycle_base != cycle_base || ctx.scale != scale ||
+                     with_delta != print_delta ||
+                     (with_delta && ctx.delta != delta))) {
+            time = ctx.time;
+            delta = ctx.delta;
+            cycle_base = ctx.cycle_base;
+            scale = ctx.scale;
+            print_delta = with_delta;
+            valid = true;
+            text.clear();
+            text.push_back('[');
+            if (unlikely(cycle_base))
+                append_uint(text, time / cycle_base, 7);
+            else
+                append_time(text, time, 20, scale);
+            if (unlikely(print_delta)) {
+                text.push_back('(');
+                append_uint(text, delta, 5);
+                text.push_back(')');
             }
+            text.push_back(']');
         }
-        if (unlikely(rep.get_id() >= 0))
-            os << "("
-               << "IWEF"[rep.get_severity()] << rep.get_id() << ") "
-               << rep.get_msg_type() << ": ";
-        else if (cfg.msg_type_field_width) {
-            if (cfg.msg_type_field_width ==
-                std::numeric_limits<unsigned>::max())
-                os << rep.get_msg_type() << ": ";
-            else
-                os << padded(rep.get_msg_type(), cfg.msg_type_field_width)
-                   << ": ";
-        }
-        if (*rep.get_msg())
-            os << rep.get_msg();
-        if (rep.get_severity() >= cfg.file_info_from) {
-            if (rep.get_line_number())
-                os << "\n         [FILE:" << rep.get_file_name() << ":"
-                   << rep.get_line_number() << "]";
-            sc_core::sc_simcontext* simc = sc_core::sc_get_curr_simcontext();
-            if (simc && sc_core::sc_is_running()) {
-                const char* proc_name = rep.get_process_name();
-                if (proc_name)
-                    os << "\n         [PROCESS:" << proc_name << "]";
+        return { text.data(), text.size() };
+    }
+};
+
+/* the scale is only determined for times other than 0 as this fixes the
+ * time resolution */
+inline auto current_context() -> sim_context {
+    sc_core::sc_simcontext* simc = sc_core::sc_get_curr_simcontext();
+    auto time = sc_core::sc_time_stamp().value();
+    return { time, sc_core::sc_delta_count(), log_cfg.cycle_base.value(),
+             simc && sc_core::sc_is_running(),
+             time ? time_resolution_scale() : 0U };
+}
+
+/* a message handed over by scp::report_direct(). It provides the same
+ * accessors as sc_core::sc_report so that both can be processed by the same
+ * code */
+struct direct_report {
+    sc_core::sc_severity severity;
+    const char* msg_type;
+    const char* msg;
+    int verbosity;
+    const char* file;
+    int line;
+
+    auto get_severity() const -> sc_core::sc_severity { return severity; }
+    auto get_msg_type() const -> const char* { return msg_type; }
+    auto get_msg() const -> const char* { return msg; }
+    auto get_verbosity() const -> int { return verbosity; }
+    auto get_file_name() const -> const char* { return file; }
+    auto get_line_number() const -> int { return line; }
+    auto get_id() const -> int { return -1; }
+    auto get_process_name() const -> const char* {
+        auto h = sc_core::sc_get_current_process_handle();
+        return h.valid() ? h.name() : nullptr;
+    }
+};
+
+/* a message handed over by scp::report_deferred() */
+struct deferred_entry : public direct_report {
+    deferred_entry(const direct_report& rep, const scp::deferred_message& msg):
+        direct_report(rep), deferred(msg) {}
+    const scp::deferred_message& deferred;
+};
+
+/* the format functions of the deferred messages. The logging thread looks
+ * the function of a record up by its index, so no code pointer is taken
+ * from the data passed to spdlog */
+class deferred_formats
+{
+public:
+    using format_fn = scp::deferred_message::format_fn;
+
+    auto add(format_fn format) -> uint32_t {
+        auto id = count.fetch_add(1, std::memory_order_relaxed);
+        if (id >= table.size())
+            return scp::deferred_message::no_format_id;
+        table[id].store(format, std::memory_order_release);
+        return id;
+    }
+    //! the function of the index or nullptr if there is none
+    auto get(uint32_t id) const -> format_fn {
+        return id < table.size() ? table[id].load(std::memory_order_acquire)
+                                 : nullptr;
+    }
+
+private:
+    std::array<std::atomic<format_fn>, 4096> table{};
+    std::atomic<uint32_t> count{ 0 };
+};
+
+auto get_deferred_formats() -> deferred_formats& {
+    static deferred_formats formats;
+    return formats;
+}
+
+/* the function name of the source location of a deferred message passed to
+ * spdlog, it tells the deferred_formatter that the payload is a record */
+const char deferred_record[] = "scp::report_deferred";
+
+/* the header of a deferred message as it is passed to spdlog. It is followed
+ * by the packed arguments, the message type and the process name (both
+ * including the terminating zero) */
+struct deferred_header {
+    uint32_t format_id;
+    const char* fmt;
+    uint64_t fmt_size;
+    const char* file;
+    sim_context ctx;
+    int32_t severity;
+    int32_t verbosity;
+    int32_t line;
+    uint32_t args_size;
+    uint32_t type_size;
+    uint32_t process_size;
+};
+
+/* a deferred message decoded in the logging thread */
+struct deferred_report {
+    deferred_header hdr;
+    const char* msg_type;
+    const char* process;
+    std::string& msg;
+
+    auto get_severity() const -> sc_core::sc_severity {
+        return static_cast<sc_core::sc_severity>(hdr.severity);
+    }
+    auto get_msg_type() const -> const char* { return msg_type; }
+    auto get_msg() const -> const char* { return msg.c_str(); }
+    auto get_verbosity() const -> int { return hdr.verbosity; }
+    auto get_file_name() const -> const char* { return hdr.file; }
+    auto get_line_number() const -> int { return hdr.line; }
+    auto get_id() const -> int { return -1; }
+    auto get_process_name() const -> const char* { return process; }
+};
+
+/* a message kept by the flight_recorder. The strings are copies as the
+ * report may not outlive the handler, they keep their capacity when the
+ * slot is reused */
+struct recorded_report {
+    sim_context ctx;
+    sc_core::sc_severity severity;
+    int verbosity;
+    int line;
+    int id;
+    std::string msg_type;
+    std::string msg;
+    std::string file;
+    std::string process;
+    bool has_process;
+    //! the message of a deferred report, formatted when the entry is dumped
+    scp::deferred_message deferred;
+
+    auto get_severity() const -> sc_core::sc_severity { return severity; }
+    auto get_msg_type() const -> const char* { return msg_type.c_str(); }
+    auto get_msg() const -> const char* { return msg.c_str(); }
+    auto get_verbosity() const -> int { return verbosity; }
+    auto get_file_name() const -> const char* { return file.c_str(); }
+    auto get_line_number() const -> int { return line; }
+    auto get_id() const -> int { return id; }
+    auto get_process_name() const -> const char* {
+        return has_process ? process.c_str() : nullptr;
+    }
+};
+
+/* ring buffer holding the last messages of the thread including those above
+ * the logging level (see scp::LogConfig::flightRecorder()). Recording copies
+ * the raw message, it is composed only if the ring is dumped */
+class flight_recorder
+{
+public:
+    auto enabled() const -> bool { return !slots.empty(); }
+
+    void resize(size_t size) {
+        slots.resize(size);
+        next = 0;
+        used = 0;
+    }
+
+    template <typename REPORT> void record(const REPORT& rep) {
+        auto& e = store(rep);
+        e.msg.assign(rep.get_msg());
+        e.deferred.format = nullptr;
+    }
+
+    void record(const deferred_entry& rep) {
+        auto& e = store(rep);
+        e.msg.clear();
+        e.deferred = rep.deferred;
+    }
+
+    /* calls f for the recorded messages, oldest first, and empties the
+     * ring */
+    template <typename FUNC> void dump(FUNC f) {
+        auto first = next + slots.size() - used;
+        for (size_t i = 0; i < used; ++i) {
+            auto& e = slots[(first + i) % slots.size()];
+            if (e.deferred.format) {
+                e.deferred.format_to(e.msg);
+                e.deferred.format = nullptr;
             }
+            f(e);
         }
-        return os.str();
-    } else
-        return "";
+        used = 0;
+    }
+
+    auto size() const -> size_t { return used; }
+
+private:
+    template <typename REPORT> auto store(const REPORT& rep)
+        -> recorded_report& {
+        auto& e = slots[next];
+        next = (next + 1) % slots.size();
+        used = std::min(used + 1, slots.size());
+        e.ctx = current_context();
+        e.severity = rep.get_severity();
+        e.verbosity = rep.get_verbosity();
+        e.line = rep.get_line_number();
+        e.id = rep.get_id();
+        e.msg_type.assign(rep.get_msg_type());
+        e.file.assign(rep.get_file_name() ? rep.get_file_name() : "");
+        auto process = e.ctx.running ? rep.get_process_name() : nullptr;
+        e.has_process = process;
+        if (process)
+            e.process.assign(process);
+        return e;
+    }
+
+    std::vector<recorded_report> slots;
+    size_t next{ 0 };
+    size_t used{ 0 };
+};
+
+thread_local flight_recorder recorder;
+
+/* the simulation state of the report, recorded messages keep the state they
+ * have been reported in */
+template <typename REPORT>
+inline auto context_of(const REPORT&) -> sim_context {
+    return current_context();
+}
+
+inline auto context_of(const recorded_report& rep) -> sim_context {
+    return rep.ctx;
+}
+
+/* counters per message type (see scp::LogConfig::collectStatistics()). A
+ * message is counted by write_outputs() between begin() and end(), the
+ * costs are measured for every sample_period-th message of a type and
+ * scaled */
+class statistics
+{
+public:
+    using clock = std::chrono::steady_clock;
+    static constexpr uint64_t sample_period = 16;
+
+    void begin(const char* type) {
+        cur = &get(type);
+        sampled = (cur->written + cur->filtered) % sample_period == 0;
+        written = false;
+    }
+
+    void end() {
+        ++(written ? cur->written : cur->filtered);
+        cur = nullptr;
+    }
+
+    //! counts a message not passed to write_outputs()
+    void filter(const char* type) { ++get(type).filtered; }
+
+    //! the start of the composition of the message for an output
+    auto start() const -> clock::time_point {
+        return unlikely(cur && sampled) ? clock::now() : clock::time_point();
+    }
+
+    //! counts the composed bytes, returns the start of the output
+    auto composed(clock::time_point start, size_t bytes)
+        -> clock::time_point {
+        if (likely(!cur))
+            return start;
+        cur->bytes += bytes;
+        return lap(start, cur->compose_ns);
+    }
+
+    //! counts the time spent in the output
+    void written_to(clock::time_point start) {
+        if (likely(!cur))
+            return;
+        written = true;
+        lap(start, cur->output_ns);
+    }
+
+    auto get_all() const -> std::vector<scp::log_statistics> {
+        std::vector<scp::log_statistics> all;
+        all.reserve(entries.size());
+        for (auto& e : entries)
+            all.push_back(e.second);
+        std::sort(all.begin(), all.end(),
+                  [](const scp::log_statistics& a,
+                     const scp::log_statistics& b) {
+                      return a.bytes > b.bytes ||
+                             (a.bytes == b.bytes && a.msg_type < b.msg_type);
+                  });
+        return all;
+    }
+
+    auto empty() const -> bool { return entries.empty(); }
+
+    void clear() { entries.clear(); }
+
+private:
+    auto get(const char* type) -> scp::log_statistics& {
+        auto& e = entries[char_hash(type)];
+        // a hash collision replaces the old counters
+        if (unlikely(e.msg_type != type)) {
+            e = scp::log_statistics();
+            e.msg_type = type;
+        }
+        return e;
+    }
+
+    auto lap(clock::time_point start, uint64_t& ns) -> clock::time_point {
+        if (!sampled)
+            return start;
+        auto now = clock::now();
+        ns += sample_period *
+              std::chrono::duration_cast<std::chrono::nanoseconds>(now -
+                                                                   start)
+                  .count();
+        return now;
+    }
+
+    std::unordered_map<uint64_t, scp::log_statistics> entries;
+    scp::log_statistics* cur{ nullptr };
+    bool sampled{ false };
+    bool written{ false };
+};
+
+thread_local statistics stats;
+
+template <typename REPORT>
+inline auto is_filtered(const REPORT& rep, output& out) -> bool {
+    return rep.get_severity() <= sc_core::SC_INFO &&
+           out.cfg.log_filter_regex.length() != 0 &&
+           rep.get_verbosity() != sc_core::SC_MEDIUM &&
+           !out.filter.match(rep.get_msg_type());
 }
 
-inline auto get_verbosity(const sc_core::sc_report& rep) -> int {
+template <typename REPORT>
+void compose_message(const REPORT& rep, const scp::LogConfig& cfg,
+                     const sim_context& ctx, buffer_t& os) {
+    if (likely(cfg.print_sim_time)) {
+        thread_local time_prefix prefix;
+        auto str = prefix.get(ctx, cfg.print_delta);
+        os.append(str.data(), str.data() + str.size());
+    }
+    if (unlikely(rep.get_id() >= 0)) {
+        os.push_back('(');
+        os.push_back("IWEF"[rep.get_severity()]);
+        append_uint(os, rep.get_id());
+        append(os, ") ", 2);
+        append(os, rep.get_msg_type());
+        append(os, ": ", 2);
+    } else if (cfg.msg_type_field_width) {
+        if (cfg.msg_type_field_width == std::numeric_limits<unsigned>::max())
+            append(os, rep.get_msg_type());
+        else
+            append_padded(os, rep.get_msg_type(), cfg.msg_type_field_width);
+        append(os, ": ", 2);
+    }
+    append(os, rep.get_msg());
+    if (rep.get_severity() >= cfg.file_info_from) {
+        if (rep.get_line_number()) {
+            append(os, "\n         [FILE:");
+            append(os, rep.get_file_name());
+            os.push_back(':');
+            append_uint(os, rep.get_line_number());
+            os.push_back(']');
+        }
+        if (ctx.running) {
+            const char* proc_name = rep.get_process_name();
+            if (proc_name) {
+                append(os, "\n         [PROCESS:");
+                append(os, proc_name);
+                os.push_back(']');
+            }
+        }
+    }
+}
+
+template <typename REPORT>
+inline auto get_verbosity(const REPORT& rep) -> int {
     return rep.get_verbosity() > sc_core::SC_NONE &&
                    rep.get_verbosity() < sc_core::SC_LOW
                ? rep.get_verbosity() * 10
                : rep.get_verbosity();
 }
 
-inline void log2logger(spdlog::logger& logger, const sc_core::sc_report& rep,
-                       const scp::LogConfig& cfg) {
-    auto msg = compose_message(rep, cfg);
-    if (!msg.size())
-        return;
+const std::array<const char*, 4> severity_names{ "INFO", "WARNING", "ERROR",
+                                                 "FATAL" };
+
+/* appends the string as JSON string. Runs of characters which need no
+ * escaping are appended at once */
+inline void append_json(buffer_t& buf, const char* str) {
+    buf.push_back('"');
+    auto start = str;
+    for (; *str; ++str) {
+        auto c = static_cast<unsigned char>(*str);
+        if (likely(c >= 0x20 && c != '"' && c != '\\'))
+            continue;
+        append(buf, start, str - start);
+        start = str + 1;
+        switch (c) {
+        case '"':
+            append(buf, "\\\"", 2);
+            break;
+        case '\\':
+            append(buf, "\\\\", 2);
+            break;
+        case '\n':
+            append(buf, "\\n", 2);
+            break;
+        case '\r':
+            append(buf, "\\r", 2);
+            break;
+        case '\t':
+            append(buf, "\\t", 2);
+            break;
+        default:
+            append(buf, "\\u00", 4);
+            buf.push_back("0123456789abcdef"[c >> 4]);
+            buf.push_back("0123456789abcdef"[c & 0xf]);
+        }
+    }
+    append(buf, start, str - start);
+    buf.push_back('"');
+}
+
+/* appends the string as quoted CSV field, quotes are doubled */
+inline void append_csv(buffer_t& buf, const char* str) {
+    buf.push_back('"');
+    for (auto quote = std::strchr(str, '"'); quote;
+         quote = std::strchr(str, '"')) {
+        append(buf, str, quote - str + 1);
+        buf.push_back('"');
+        str = quote + 1;
+    }
+    append(buf, str);
+    buf.push_back('"');
+}
+
+const char csv_header[] =
+    "time,delta,severity,verbosity,msg_type,file,line,process,message\n";
+
+/* composes one JSON object or CSV line holding the fields of the report.
+ * The time is given in ticks of the time resolution */
+template <typename REPORT>
+void compose_record(const REPORT& rep, const scp::LogConfig& cfg,
+                    const sim_context& ctx, buffer_t& os) {
+    auto file = rep.get_file_name();
+    auto process = ctx.running ? rep.get_process_name() : nullptr;
+    if (cfg.output_format == scp::log_format::JSON) {
+        append(os, "{\"time\":", 8);
+        append_uint(os, ctx.time);
+        append(os, ",\"delta\":", 9);
+        append_uint(os, ctx.delta);
+        append(os, ",\"severity\":\"", 13);
+        append(os, severity_names[rep.get_severity()]);
+        append(os, "\",\"verbosity\":", 14);
+        append_uint(os, get_verbosity(rep));
+        append(os, ",\"msg_type\":", 12);
+        append_json(os, rep.get_msg_type());
+        append(os, ",\"file\":", 8);
+        append_json(os, file ? file : "");
+        append(os, ",\"line\":", 8);
+        append_uint(os, rep.get_line_number());
+        append(os, ",\"process\":", 11);
+        append_json(os, process ? process : "");
+        append(os, ",\"message\":", 11);
+        append_json(os, rep.get_msg());
+        os.push_back('}');
+    } else {
+        append_uint(os, ctx.time);
+        os.push_back(',');
+        append_uint(os, ctx.delta);
+        os.push_back(',');
+        append(os, severity_names[rep.get_severity()]);
+        os.push_back(',');
+        append_uint(os, get_verbosity(rep));
+        os.push_back(',');
+        append_csv(os, rep.get_msg_type());
+        os.push_back(',');
+        append_csv(os, file ? file : "");
+        os.push_back(',');
+        append_uint(os, rep.get_line_number());
+        os.push_back(',');
+        append_csv(os, process ? process : "");
+        os.push_back(',');
+        append_csv(os, rep.get_msg());
+    }
+}
+
+/* composes the message in the output format of the configuration */
+template <typename REPORT>
+inline void compose(const REPORT& rep, const scp::LogConfig& cfg,
+                    const sim_context& ctx, buffer_t& os) {
+    if (likely(cfg.output_format == scp::log_format::TEXT))
+        compose_message(rep, cfg, ctx, os);
+    else
+        compose_record(rep, cfg, ctx, os);
+}
+
+template <typename REPORT>
+inline auto get_level(const REPORT& rep) -> spdlog::level::level_enum {
     switch (rep.get_severity()) {
     case sc_core::SC_INFO:
         switch (get_verbosity(rep)) {
         case sc_core::SC_DEBUG:
         case sc_core::SC_FULL:
-            logger.trace(msg);
-            break;
+            return spdlog::level::trace;
         case sc_core::SC_HIGH:
-            logger.debug(msg);
-            break;
+            return spdlog::level::debug;
         default:
-            logger.info(msg);
-            break;
+            return spdlog::level::info;
         }
-        break;
     case sc_core::SC_WARNING:
-        logger.warn(msg);
-        break;
+        return spdlog::level::warn;
     case sc_core::SC_ERROR:
-        logger.error(msg);
-        break;
+        return spdlog::level::err;
     case sc_core::SC_FATAL:
-        logger.critical(msg);
-        break;
+        return spdlog::level::critical;
     default:
-        break;
+        return spdlog::level::off;
+    }
+}
+
+/* the level of the report as used by the LogSinks */
+template <typename REPORT>
+inline auto get_log_level(const REPORT& rep) -> scp::log {
+    switch (rep.get_severity()) {
+    case sc_core::SC_INFO: {
+        auto v = get_verbosity(rep);
+        return v >= sc_core::SC_DEBUG  ? scp::log::TRACEALL
+               : v >= sc_core::SC_FULL ? scp::log::TRACE
+               : v >= sc_core::SC_HIGH ? scp::log::DEBUG
+                                       : scp::log::INFO;
+    }
+    case sc_core::SC_WARNING:
+        return scp::log::WARNING;
+    case sc_core::SC_ERROR:
+        return scp::log::ERROR;
+    default:
+        return scp::log::FATAL;
+    }
+}
+
+/* requests writing all messages logged to the output so far */
+inline void flush(output& out) {
+    out.drain->request();
+    out.logger->flush();
+}
+
+template <typename REPORT>
+inline void log2logger(output& out, const REPORT& rep) {
+    auto lvl = get_level(rep);
+    if (lvl == spdlog::level::off || is_filtered(rep, out))
+        return;
+    // reused to avoid allocations
+    thread_local buffer_t buf;
+    buf.clear();
+    auto start = stats.start();
+    compose(rep, out.cfg, context_of(rep), buf);
+    start = stats.composed(start, buf.size());
+    out.logger->log(lvl, spdlog::string_view_t(buf.data(), buf.size()));
+    if (lvl >= spdlog::level::warn)
+        flush(out);
+    stats.written_to(start);
+}
+
+/* encodes the deferred message, the formatting is done by the
+ * deferred_formatter of the logger's sinks */
+inline void log2logger(output& out, const deferred_entry& rep) {
+    if (is_filtered(rep, out))
+        return;
+    auto& cfg = out.cfg;
+    thread_local spdlog::memory_buf_t buf;
+    auto start = stats.start();
+    const char* process = nullptr;
+    if (rep.get_severity() >= cfg.file_info_from ||
+        cfg.output_format != scp::log_format::TEXT)
+        process = rep.get_process_name();
+    deferred_header hdr{ rep.deferred.format_id,
+                         rep.deferred.fmt,
+                         rep.deferred.fmt_size,
+                         rep.get_file_name(),
+                         current_context(),
+                         rep.get_severity(),
+                         rep.get_verbosity(),
+                         rep.get_line_number(),
+                         static_cast<uint32_t>(rep.deferred.size),
+                         static_cast<uint32_t>(
+                             std::strlen(rep.get_msg_type()) + 1),
+                         process ? static_cast<uint32_t>(
+                                       std::strlen(process) + 1)
+                                 : 0U };
+    buf.clear();
+    auto append = [](const void* p, size_t n) {
+        auto c = static_cast<const char*>(p);
+        buf.append(c, c + n);
+    };
+    append(&hdr, sizeof(hdr));
+    append(rep.deferred.args, hdr.args_size);
+    append(rep.get_msg_type(), hdr.type_size);
+    if (process)
+        append(process, hdr.process_size);
+    start = stats.composed(start, buf.size());
+    out.logger->log(spdlog::source_loc{ nullptr, 0, deferred_record },
+                    get_level(rep),
+                    spdlog::string_view_t(buf.data(), buf.size()));
+    stats.written_to(start);
+}
+
+/* formatter wrapping the pattern formatter of a sink. It composes deferred
+ * messages, which are marked by their source location, before passing them
+ * on. All other messages are passed unchanged */
+class deferred_formatter : public spdlog::formatter
+{
+public:
+    deferred_formatter(std::unique_ptr<spdlog::formatter> inner,
+                       const scp::LogConfig& cfg):
+        inner(std::move(inner)), cfg(cfg) {}
+
+    void format(const spdlog::details::log_msg& msg,
+                spdlog::memory_buf_t& dest) override {
+        if (msg.source.funcname != deferred_record) {
+            inner->format(msg, dest);
+            return;
+        }
+        auto& payload = msg.payload;
+        deferred_header hdr;
+        scp::deferred_message::format_fn format = nullptr;
+        if (payload.size() >= sizeof(hdr)) {
+            std::memcpy(&hdr, payload.data(), sizeof(hdr));
+            if (payload.size() == sizeof(hdr) + hdr.args_size +
+                                      hdr.type_size + hdr.process_size &&
+                hdr.args_size <= scp::deferred_message::capacity)
+                format = get_deferred_formats().get(hdr.format_id);
+        }
+        if (!format) {
+            spdlog::details::log_msg m(msg);
+            m.payload = "invalid deferred message";
+            inner->format(m, dest);
+            return;
+        }
+        auto args = reinterpret_cast<const unsigned char*>(payload.data()) +
+                    sizeof(hdr);
+        auto type = reinterpret_cast<const char*>(args) + hdr.args_size;
+        auto process = hdr.process_size ? type + hdr.type_size : nullptr;
+        text.clear();
+        format(text, hdr.fmt, hdr.fmt_size, args);
+        deferred_report rep{ hdr, type, process, text };
+        composed.clear();
+        compose(rep, cfg, hdr.ctx, composed);
+        spdlog::details::log_msg m(msg);
+        m.payload = spdlog::string_view_t(composed.data(), composed.size());
+        inner->format(m, dest);
+        msg.color_range_start = m.color_range_start;
+        msg.color_range_end = m.color_range_end;
+    }
+
+    auto clone() const -> std::unique_ptr<spdlog::formatter> override {
+        return std::unique_ptr<spdlog::formatter>(
+            new deferred_formatter(inner->clone(), cfg));
+    }
+
+private:
+    std::unique_ptr<spdlog::formatter> inner;
+    const scp::LogConfig cfg;
+    std::string text;
+    buffer_t composed;
+};
+
+void set_pattern(spdlog::logger& logger, const std::string& pattern,
+                 const scp::LogConfig& cfg) {
+    if (cfg.deferred_formatting)
+        logger.set_formatter(
+            std::unique_ptr<spdlog::formatter>(new deferred_formatter(
+                std::unique_ptr<spdlog::formatter>(
+                    new spdlog::pattern_formatter(pattern)),
+                cfg)));
+    else
+        logger.set_pattern(pattern);
+}
+
+/* a report as it is passed to the mapped_file_sink in binary mode. It is
+ * followed by the message type, the message, the file name and the process
+ * name (all including the terminating zero) */
+struct binary_header {
+    uint64_t magic;
+    sim_context ctx;
+    uint32_t type_field_width;
+    int32_t file_info_from;
+    bool print_sim_time;
+    bool print_delta;
+    int32_t severity;
+    int32_t verbosity;
+    int32_t line;
+    int32_t id;
+    uint32_t type_size;
+    uint32_t msg_size;
+    uint32_t file_size;
+    uint32_t process_size; // 0 if there is no process name
+};
+constexpr uint64_t binary_magic = 0x4e494250435300ULL << 8;
+
+template <typename REPORT>
+inline auto get_message(const REPORT& rep) -> const char* {
+    return rep.get_msg();
+}
+
+/* deferred messages are formatted right away in binary mode as the format
+ * function cannot be stored in the file */
+inline auto get_message(const deferred_entry& rep) -> const char* {
+    thread_local std::string text;
+    text.clear();
+    rep.deferred.format_to(text);
+    return text.c_str();
+}
+
+/* encodes the report, it is written by the mapped_file_sink of the logger */
+template <typename REPORT>
+inline void log2binary(output& out, const REPORT& rep) {
+    auto lvl = get_level(rep);
+    if (lvl == spdlog::level::off || is_filtered(rep, out))
+        return;
+    auto& cfg = out.cfg;
+    thread_local spdlog::memory_buf_t buf;
+    auto start = stats.start();
+    auto ctx = context_of(rep);
+    const char* process = nullptr;
+    if (ctx.running && rep.get_severity() >= cfg.file_info_from)
+        process = rep.get_process_name();
+    auto msg = get_message(rep);
+    auto file = rep.get_file_name() ? rep.get_file_name() : "";
+    binary_header hdr{ binary_magic,
+                       ctx,
+                       cfg.msg_type_field_width,
+                       cfg.file_info_from,
+                       cfg.print_sim_time,
+                       cfg.print_delta,
+                       rep.get_severity(),
+                       rep.get_verbosity(),
+                       rep.get_line_number(),
+                       rep.get_id(),
+                       static_cast<uint32_t>(
+                           std::strlen(rep.get_msg_type()) + 1),
+                       static_cast<uint32_t>(std::strlen(msg) + 1),
+                       static_cast<uint32_t>(std::strlen(file) + 1),
+                       process ? static_cast<uint32_t>(
+                                     std::strlen(process) + 1)
+                               : 0U };
+    buf.clear();
+    auto append = [](const void* p, size_t n) {
+        auto c = static_cast<const char*>(p);
+        buf.append(c, c + n);
+    };
+    append(&hdr, sizeof(hdr));
+    append(rep.get_msg_type(), hdr.type_size);
+    append(msg, hdr.msg_size);
+    append(file, hdr.file_size);
+    if (process)
+        append(process, hdr.process_size);
+    start = stats.composed(start, buf.size());
+    out.logger->log(lvl, spdlog::string_view_t(buf.data(), buf.size()));
+    if (lvl >= spdlog::level::warn)
+        flush(out);
+    stats.written_to(start);
+}
+
+/* the binary log file format. Each segment starts with the magic followed
+ * by a byte telling if the severity is printed. The records are a tag byte
+ * followed by unsigned LEB128 numbers (signed ones zigzag encoded), single
+ * bytes and strings prefixed by their length:
+ *  - string: text; defines the next string id (starting at 1)
+ *  - config: type field width, file info level, print sim time, print
+ *            delta; the settings used to compose the following reports
+ *  - report: level, severity, flags, scale, verbosity, id, time, delta,
+ *            cycle base, type id, file id, line, process id (0 if none),
+ *            message
+ *  - text:   level, text; for messages not passed as binary_header
+ * The unused rest of a segment is filled with zeros (tag end). */
+const char binary_file_magic[8] = { 'S', 'C', 'P', 'L', 'O', 'G', 0, 1 };
+enum binary_tag : uint8_t {
+    TAG_END,
+    TAG_STRING,
+    TAG_CONFIG,
+    TAG_REPORT,
+    TAG_TEXT
+};
+enum binary_flags : uint8_t { FLAG_RUNNING = 1 };
+
+inline void put_varint(buffer_t& buf, uint64_t val) {
+    while (val >= 0x80) {
+        buf.push_back(static_cast<char>((val & 0x7f) | 0x80));
+        val >>= 7;
     }
+    buf.push_back(static_cast<char>(val));
+}
+
+inline void put_svarint(buffer_t& buf, int64_t val) {
+    put_varint(buf, (static_cast<uint64_t>(val) << 1) ^
+                        static_cast<uint64_t>(val >> 63));
+}
+
+inline void put_string(buffer_t& buf, const char* str, size_t len) {
+    put_varint(buf, len);
+    append(buf, str, len);
+}
+
+/* a file of a fixed size written through a memory mapping. When it is closed
+ * it is truncated to the written size */
+class segment_file
+{
+public:
+    segment_file() = default;
+    segment_file(const segment_file&) = delete;
+    segment_file& operator=(const segment_file&) = delete;
+    ~segment_file() { close(); }
+
+    auto is_open() const -> bool { return data != nullptr; }
+    auto fits(size_t len) const -> bool { return pos + len <= size; }
+    auto used() const -> size_t { return pos; }
+
+    void write(const char* str, size_t len) {
+        std::memcpy(data + pos, str, len);
+        pos += len;
+    }
+
+#ifndef _WIN32
+    void open(const std::string& name, size_t sz) {
+        fd = ::open(name.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0)
+            spdlog::throw_spdlog_ex("Failed opening file " + name, errno);
+        pos = 0;
+        map(sz);
+    }
+
+    //! grow the file to hold at least sz bytes
+    void reserve(size_t sz) {
+        if (sz <= size)
+            return;
+        ::munmap(data, size);
+        map(sz);
+    }
+
+    void flush() {
+        if (data)
+            ::msync(data, pos, MS_ASYNC);
+    }
+
+    void close() {
+        if (!data)
+            return;
+        ::munmap(data, size);
+        data = nullptr;
+        if (::ftruncate(fd, pos) != 0) {
+            // the rest of the file stays filled with zeros
+        }
+        ::close(fd);
+        fd = -1;
+    }
+
+private:
+    void map(size_t sz) {
+        if (::ftruncate(fd, sz) != 0)
+            spdlog::throw_spdlog_ex("Failed resizing log file", errno);
+        auto p = ::mmap(nullptr, sz, PROT_READ | PROT_WRITE, MAP_SHARED, fd,
+                        0);
+        if (p == MAP_FAILED)
+            spdlog::throw_spdlog_ex("Failed mapping log file", errno);
+        data = static_cast<char*>(p);
+        size = sz;
+    }
+
+    int fd{ -1 };
+#else
+    /* no memory mapping, the content is kept in a buffer which is written
+     * when flushed */
+    void open(const std::string& name, size_t sz) {
+        file = std::fopen(name.c_str(), "wb");
+        if (!file)
+            spdlog::throw_spdlog_ex("Failed opening file " + name, errno);
+        pos = written = 0;
+        reserve(sz);
+    }
+
+    void reserve(size_t sz) {
+        if (sz <= size)
+            return;
+        buffer.resize(sz);
+        data = buffer.data();
+        size = sz;
+    }
+
+    void flush() {
+        if (!data)
+            return;
+        std::fwrite(data + written, 1, pos - written, file);
+        std::fflush(file);
+        written = pos;
+    }
+
+    void close() {
+        if (!data)
+            return;
+        flush();
+        std::fclose(file);
+        data = nullptr;
+        size = 0;
+    }
+
+private:
+    std::FILE* file{ nullptr };
+    std::vector<char> buffer;
+    size_t written{ 0 };
+#endif
+    char* data{ nullptr };
+    size_t size{ 0 };
+    size_t pos{ 0 };
+};
+
+/* sink writing the log file in segments of a fixed size. The first segment
+ * has the name of the log file, the following ones get the segment number
+ * appended (<name>.1, <name>.2, ...). If the number of segments is limited
+ * the oldest segment is removed when a new one is started. In binary mode
+ * the strings are interned per segment so that each segment can be decoded
+ * on its own */
+class mapped_file_sink : public spdlog::sinks::base_sink<std::mutex>
+{
+public:
+    explicit mapped_file_sink(const scp::LogConfig& cfg):
+        name(cfg.log_file_name),
+        segment_size(cfg.log_file_segment_size),
+        max_segments(cfg.log_file_segments),
+        binary(cfg.log_file_binary) {
+        if (binary) {
+            header.append(binary_file_magic,
+                          binary_file_magic + sizeof(binary_file_magic));
+            header.push_back(cfg.print_severity);
+        } else if (cfg.output_format == scp::log_format::CSV)
+            append(header, csv_header);
+        open_segment();
+    }
+
+protected:
+    void sink_it_(const spdlog::details::log_msg& msg) override {
+        record.clear();
+        encode(msg);
+        if (!file.fits(record.size()) && file.used() > header.size()) {
+            next_segment();
+            record.clear();
+            encode(msg);
+        }
+        file.reserve(file.used() + record.size());
+        file.write(record.data(), record.size());
+    }
+
+    void flush_() override { file.flush(); }
+
+private:
+    void encode(const spdlog::details::log_msg& msg) {
+        if (!binary) {
+            formatter_->format(msg, record);
+            return;
+        }
+        auto& payload = msg.payload;
+        binary_header hdr;
+        if (payload.size() < sizeof(hdr) ||
+            (std::memcpy(&hdr, payload.data(), sizeof(hdr)),
+             hdr.magic != binary_magic) ||
+            payload.size() != sizeof(hdr) + hdr.type_size + hdr.msg_size +
+                                  hdr.file_size + hdr.process_size) {
+            record.push_back(TAG_TEXT);
+            record.push_back(static_cast<char>(msg.level));
+            put_string(record, payload.data(), payload.size());
+            return;
+        }
+        auto type = payload.data() + sizeof(hdr);
+        auto text = type + hdr.type_size;
+        auto file_name = text + hdr.msg_size;
+        auto process = file_name + hdr.file_size;
+        auto type_id = intern(type, hdr.type_size - 1);
+        auto file_id = intern(file_name, hdr.file_size - 1);
+        auto process_id =
+            hdr.process_size ? intern(process, hdr.process_size - 1) : 0U;
+        if (!config_valid || hdr.type_field_width != config.type_field_width ||
+            hdr.file_info_from != config.file_info_from ||
+            hdr.print_sim_time != config.print_sim_time ||
+            hdr.print_delta != config.print_delta) {
+            config = hdr;
+            config_valid = true;
+            record.push_back(TAG_CONFIG);
+            put_varint(record, hdr.type_field_width);
+            put_svarint(record, hdr.file_info_from);
+            record.push_back(hdr.print_sim_time);
+            record.push_back(hdr.print_delta);
+        }
+        record.push_back(TAG_REPORT);
+        record.push_back(static_cast<char>(msg.level));
+        record.push_back(static_cast<char>(hdr.severity));
+        record.push_back(hdr.ctx.running ? FLAG_RUNNING : 0);
+        record.push_back(static_cast<char>(hdr.ctx.scale));
+        put_svarint(record, hdr.verbosity);
+        put_svarint(record, hdr.id);
+        put_varint(record, hdr.ctx.time);
+        put_varint(record, hdr.ctx.delta);
+        put_varint(record, hdr.ctx.cycle_base);
+        put_varint(record, type_id);
+        put_varint(record, file_id);
+        put_svarint(record, hdr.line);
+        put_varint(record, process_id);
+        put_string(record, text, hdr.msg_size - 1);
+    }
+
+    /* the id of the string, a new one is defined in the record if the
+     * string has not been used in this segment yet */
+    auto intern(const char* str, size_t len) -> uint32_t {
+        key.assign(str, len);
+        auto it = strings.find(key);
+        if (it != strings.end())
+            return it->second;
+        auto id = static_cast<uint32_t>(strings.size() + 1);
+        strings.emplace(key, id);
+        record.push_back(TAG_STRING);
+        put_string(record, str, len);
+        return id;
+    }
+
+    auto segment_name(unsigned idx) const -> std::string {
+        return idx ? name + "." + std::to_string(idx) : name;
+    }
+
+    void open_segment() {
+        file.open(segment_name(index), segment_size);
+        file.write(header.data(), header.size());
+        strings.clear();
+        config_valid = false;
+        if (max_segments && index >= max_segments)
+            std::remove(segment_name(index - max_segments).c_str());
+    }
+
+    void next_segment() {
+        file.close();
+        ++index;
+        open_segment();
+    }
+
+    const std::string name;
+    const size_t segment_size;
+    const unsigned max_segments;
+    const bool binary;
+    unsigned index{ 0 };
+    segment_file file;
+    buffer_t header;
+    buffer_t record;
+    std::string key;
+    std::unordered_map<std::string, uint32_t> strings;
+    binary_header config;
+    bool config_valid{ false };
+};
+
+/* reads the fields of the binary log file format */
+struct binary_reader {
+    const char* pos;
+    const char* end;
+    bool ok{ true };
+
+    auto byte() -> uint8_t {
+        if (pos == end) {
+            ok = false;
+            return 0;
+        }
+        return static_cast<uint8_t>(*pos++);
+    }
+
+    auto varint() -> uint64_t {
+        uint64_t val = 0;
+        for (unsigned shift = 0; shift < 64; shift += 7) {
+            auto b = byte();
+            val |= static_cast<uint64_t>(b & 0x7f) << shift;
+            if (!(b & 0x80))
+                return val;
+        }
+        ok = false;
+        return 0;
+    }
+
+    auto svarint() -> int64_t {
+        auto val = varint();
+        return static_cast<int64_t>(val >> 1) ^ -static_cast<int64_t>(val & 1);
+    }
+
+    auto string(std::string& str) -> bool {
+        auto len = varint();
+        if (!ok || len > static_cast<uint64_t>(end - pos))
+            return ok = false;
+        str.assign(pos, len);
+        pos += len;
+        return true;
+    }
+};
+
+/* a report read from a binary log file */
+struct decoded_report {
+    sc_core::sc_severity severity;
+    int verbosity;
+    int id;
+    int line;
+    const char* msg_type;
+    const char* file;
+    const char* process;
+    std::string msg;
+
+    auto get_severity() const -> sc_core::sc_severity { return severity; }
+    auto get_msg_type() const -> const char* { return msg_type; }
+    auto get_msg() const -> const char* { return msg.c_str(); }
+    auto get_verbosity() const -> int { return verbosity; }
+    auto get_file_name() const -> const char* { return file; }
+    auto get_line_number() const -> int { return line; }
+    auto get_id() const -> int { return id; }
+    auto get_process_name() const -> const char* { return process; }
+};
+
+/* the severity as printed by the file pattern ("[%8l] ") */
+void append_level(buffer_t& buf, uint8_t level) {
+    if (level > spdlog::level::off)
+        level = spdlog::level::off;
+    auto name = spdlog::level::to_string_view(
+        static_cast<spdlog::level::level_enum>(level));
+    buf.push_back('[');
+    if (name.size() < 8)
+        append_fill(buf, ' ', 8 - name.size());
+    buf.append(name.data(), name.data() + name.size());
+    append(buf, "] ", 2);
+}
+
+/* converts a binary segment into text */
+auto decode_binary(binary_reader& in, std::ostream& os) -> bool {
+    scp::LogConfig cfg;
+    cfg.print_severity = in.byte();
+    std::vector<std::string> strings(1);
+    buffer_t buf;
+    decoded_report rep;
+    while (in.ok && in.pos != in.end) {
+        auto tag = in.byte();
+        buf.clear();
+        switch (tag) {
+        case TAG_END:
+            return true;
+        case TAG_STRING:
+            strings.emplace_back();
+            in.string(strings.back());
+            continue;
+        case TAG_CONFIG:
+            cfg.msg_type_field_width = static_cast<unsigned>(in.varint());
+            cfg.file_info_from = static_cast<int>(in.svarint());
+            cfg.print_sim_time = in.byte();
+            cfg.print_delta = in.byte();
+            continue;
+        case TAG_TEXT: {
+            auto level = in.byte();
+            if (cfg.print_severity)
+                append_level(buf, level);
+            in.string(rep.msg);
+            append(buf, rep.msg.data(), rep.msg.size());
+            break;
+        }
+        case TAG_REPORT: {
+            auto level = in.byte();
+            rep.severity = static_cast<sc_core::sc_severity>(in.byte());
+            auto flags = in.byte();
+            sim_context ctx;
+            ctx.scale = in.byte();
+            ctx.running = flags & FLAG_RUNNING;
+            rep.verbosity = static_cast<int>(in.svarint());
+            rep.id = static_cast<int>(in.svarint());
+            ctx.time = in.varint();
+            ctx.delta = in.varint();
+            ctx.cycle_base = in.varint();
+            auto type_id = in.varint();
+            auto file_id = in.varint();
+            rep.line = static_cast<int>(in.svarint());
+            auto process_id = in.varint();
+            in.string(rep.msg);
+            if (!in.ok || !type_id || type_id >= strings.size() ||
+                !file_id || file_id >= strings.size() ||
+                process_id >= strings.size())
+                return false;
+            rep.msg_type = strings[type_id].c_str();
+            rep.file = strings[file_id].c_str();
+            rep.process = process_id ? strings[process_id].c_str() : nullptr;
+            if (cfg.print_severity)
+                append_level(buf, level);
+            compose_message(rep, cfg, ctx, buf);
+            break;
+        }
+        default:
+            return false;
+        }
+        if (!in.ok)
+            return false;
+        buf.push_back('\n');
+        os.write(buf.data(), buf.size());
+    }
+    return in.ok;
 }
 
 inline void log2logger(spdlog::logger& logger, scp::log lvl,
@@ -280,70 +1922,251 @@ inline void log2logger(spdlog::logger& logger, scp::log lvl,
     case scp::log::FATAL:
         logger.critical(msg);
         return;
-    default:
-        break;
+    default:
+        break;
+    }
+}
+
+/* the file output always contains the simulation time and the message
+ * type. The binary format is only used for segmented files */
+auto file_config(const scp::LogConfig& cfg) -> scp::LogConfig {
+    scp::LogConfig lcfg(cfg);
+    lcfg.print_sim_time = true;
+    lcfg.log_file_binary = cfg.log_file_binary && cfg.log_file_segment_size;
+    if (!lcfg.msg_type_field_width)
+        lcfg.msg_type_field_width = 24;
+    return lcfg;
+}
+
+thread_local bool sc_stop_called = false;
+
+/* writes all pending messages and waits until they are written. With
+ * async_overflow::OVERRUN_OLDEST the flush request itself may be discarded
+ * from a full queue, hence the wait is bounded */
+void drain_outputs() {
+    constexpr std::chrono::seconds overrun_timeout{ 1 };
+    for (auto& out : log_cfg.outputs)
+        flush(out);
+    auto lossy = log_cfg.log_async && log_cfg.async_overflow_policy ==
+                                          scp::async_overflow::OVERRUN_OLDEST;
+    for (auto& out : log_cfg.outputs) {
+        if (lossy)
+            out.drain->wait_for(overrun_timeout);
+        else
+            out.drain->wait();
+    }
+}
+
+template <typename REPORT>
+void write_outputs(const REPORT& rep, const sc_core::sc_actions& actions) {
+    if (unlikely(log_cfg.collect_statistics))
+        stats.begin(rep.get_msg_type());
+    auto level = get_log_level(rep);
+    for (auto& out : log_cfg.outputs) {
+        auto action = out.file ? sc_core::SC_LOG : sc_core::SC_DISPLAY;
+        if (level > out.level || !(actions & action))
+            continue;
+        if (out.cfg.log_file_binary)
+            log2binary(out, rep);
+        else
+            log2logger(out, rep);
+    }
+    if (unlikely(log_cfg.collect_statistics))
+        stats.end();
+}
+
+/* counts a message which is dropped before it reaches write_outputs() */
+template <typename REPORT> inline void count_filtered(const REPORT& rep) {
+    if (unlikely(log_cfg.collect_statistics))
+        stats.filter(rep.get_msg_type());
+}
+
+/* writes the statistics as table, sorted by the number of bytes */
+void write_statistics() {
+    using ms = std::chrono::duration<double, std::milli>;
+    std::ostringstream os;
+    os << "logging statistics:\n"
+       << std::left << std::setw(32) << "message type" << std::right
+       << std::setw(11) << "written" << std::setw(11) << "filtered"
+       << std::setw(13) << "bytes" << std::setw(13) << "compose ms"
+       << std::setw(13) << "output ms" << std::fixed << std::setprecision(3);
+    for (auto& s : stats.get_all())
+        os << "\n"
+           << std::left << std::setw(32) << s.msg_type << std::right
+           << std::setw(11) << s.written << std::setw(11) << s.filtered
+           << std::setw(13) << s.bytes << std::setw(13)
+           << ms(std::chrono::nanoseconds(s.compose_ns)).count()
+           << std::setw(13)
+           << ms(std::chrono::nanoseconds(s.output_ns)).count();
+    // the table is not counted itself
+    log_cfg.collect_statistics = false;
+    write_outputs(direct_report{ sc_core::SC_INFO, "scp.statistics",
+                                 os.str().c_str(), sc_core::SC_MEDIUM, "",
+                                 0 },
+                  sc_core::SC_LOG | sc_core::SC_DISPLAY);
+}
+
+/* writes the number of messages suppressed by the rate limit */
+void write_summary(rate_limiter::state& st) {
+    thread_local std::string msg;
+    msg.assign("suppressed ");
+    msg.append(fmt::format_int(st.suppressed).c_str());
+    msg.append(" similar messages");
+    write_outputs(direct_report{ st.severity, st.type.c_str(), msg.c_str(),
+                                 st.verbosity, st.file.c_str(), st.line },
+                  sc_core::SC_LOG | sc_core::SC_DISPLAY);
+    st.suppressed = 0;
+}
+
+/* writes the messages of the flight recorder between two notes */
+void dump_recorder() {
+    if (!recorder.size())
+        return;
+    auto note = [](const char* text) {
+        write_outputs(direct_report{ sc_core::SC_INFO, "scp.flight_recorder",
+                                     text, sc_core::SC_MEDIUM, "", 0 },
+                      sc_core::SC_LOG | sc_core::SC_DISPLAY);
+    };
+    thread_local std::string msg;
+    msg.assign("the last ");
+    msg.append(fmt::format_int(recorder.size()).c_str());
+    msg.append(" recorded messages:");
+    note(msg.c_str());
+    recorder.dump([](const recorded_report& rep) {
+        write_outputs(rep, sc_core::SC_LOG | sc_core::SC_DISPLAY);
+    });
+    note("end of the recorded messages");
+}
+
+/* set if the message reported next by the calling thread passed the rate
+ * limit in scp::rate_limit_passed(), so it is not counted again */
+thread_local bool rate_checked{ false };
+
+/* applies the rate limit to info and warning messages */
+template <typename REPORT>
+inline auto is_suppressed(const REPORT& rep) -> bool {
+    if (likely(!log_cfg.rate_limit) ||
+        rep.get_severity() > sc_core::SC_WARNING)
+        return false;
+    return log_cfg.limiter.check(rep, log_cfg,
+                                 sc_core::sc_time_stamp().value(),
+                                 write_summary);
+}
+
+/* set by scp::record_only() for the message the calling thread reports
+ * next, the message is then only recorded */
+thread_local bool record_only_pending{ false };
+/* set if the message reported next by the calling thread has been recorded
+ * by record_message() already */
+thread_local bool recorded{ false };
+
+/* records a message of the SCP_ macros before a report is created for it,
+ * returns true if the message is only recorded */
+template <typename REPORT>
+inline auto record_message(const REPORT& rep) -> bool {
+    if (likely(!recorder.enabled()) || recorded)
+        return false;
+    if (rep.get_severity() < sc_core::SC_ERROR) {
+        recorder.record(rep);
+        recorded = true;
     }
+    if (!record_only_pending)
+        return false;
+    record_only_pending = false;
+    recorded = false;
+    count_filtered(rep);
+    return true;
 }
 
-void report_handler(const sc_core::sc_report& rep,
-                    const sc_core::sc_actions& actions) {
-    thread_local bool sc_stop_called = false;
+/* only an sc_report is thrown, the other reports never get SC_THROW as
+ * info_actions::execute() leaves such messages to sc_report_handler */
+inline void throw_report(const sc_core::sc_report& rep) { throw rep; }
+template <typename REPORT> inline void throw_report(const REPORT&) {}
+
+template <typename REPORT>
+void handle_report(const REPORT& rep, const sc_core::sc_actions& actions) {
+    auto checked = rate_checked;
+    auto was_recorded = recorded;
+    rate_checked = false;
+    recorded = false;
     if (actions & sc_core::SC_DO_NOTHING)
         return;
     // If logging has been shut down, silently ignore log messages
     // This can happen during static destruction when LoggingGuard is destroyed
     // before other static objects that log in their destructors
-    if (!log_cfg.console_logger)
+    if (log_cfg.outputs.empty())
         return;
-    if (rep.get_severity() == sc_core::SC_INFO ||
-        !log_cfg.report_only_first_error ||
-        sc_core::sc_report_handler::get_count(sc_core::SC_ERROR) < 2) {
-        if ((actions & sc_core::SC_DISPLAY) &&
-            (!log_cfg.file_logger || get_verbosity(rep) < sc_core::SC_HIGH))
-            log2logger(*log_cfg.console_logger, rep, log_cfg);
-        if ((actions & sc_core::SC_LOG) && log_cfg.file_logger) {
-            scp::LogConfig lcfg(log_cfg);
-            lcfg.print_sim_time = true;
-            if (!lcfg.msg_type_field_width)
-                lcfg.msg_type_field_width = 24;
-            log2logger(*log_cfg.file_logger, rep, lcfg);
-        }
-    }
+    if (unlikely(recorder.enabled()) && !was_recorded &&
+        rep.get_severity() < sc_core::SC_ERROR)
+        recorder.record(rep);
+    if ((rep.get_severity() == sc_core::SC_INFO ||
+         !log_cfg.report_only_first_error ||
+         sc_core::sc_report_handler::get_count(sc_core::SC_ERROR) < 2) &&
+        (checked || !is_suppressed(rep))) {
+        if (rep.get_severity() >= sc_core::SC_ERROR)
+            dump_recorder();
+        write_outputs(rep, actions);
+    } else
+        count_filtered(rep);
+    // the messages are written before the simulation ends or the report
+    // leaves the handler
+    if (actions & (sc_core::SC_STOP | sc_core::SC_ABORT | sc_core::SC_THROW))
+        drain_outputs();
     if (actions & sc_core::SC_STOP) {
-        std::this_thread::sleep_for(std::chrono::milliseconds(
-            static_cast<unsigned>(log_cfg.level) * 10));
         if (sc_core::sc_is_running() && !sc_stop_called) {
             sc_core::sc_stop();
             sc_stop_called = true;
         }
     }
-    if (actions & sc_core::SC_ABORT) {
-        std::this_thread::sleep_for(std::chrono::milliseconds(
-            static_cast<unsigned>(log_cfg.level) * 20));
+    if (actions & sc_core::SC_ABORT)
         abort();
-    }
-    if (actions & sc_core::SC_THROW) {
-        std::this_thread::sleep_for(std::chrono::milliseconds(
-            static_cast<unsigned>(log_cfg.level) * 20));
-        throw rep;
-    }
+    if (actions & sc_core::SC_THROW)
+        throw_report(rep);
     if (sc_core::sc_time_stamp().value() && !sc_core::sc_is_running()) {
-        log_cfg.console_logger->flush();
-        if (log_cfg.file_logger)
-            log_cfg.file_logger->flush();
+        for (auto& out : log_cfg.outputs)
+            flush(out);
     }
 }
 
-// BKDR hash algorithm
-auto char_hash(char const* str) -> uint64_t {
-    constexpr unsigned int seed = 131; // 31  131 1313 13131131313 etc//
-    uint64_t hash = 0;
-    while (*str) {
-        hash = (hash * seed) + (*str);
-        str++;
-    }
-    return hash;
+void report_handler(const sc_core::sc_report& rep,
+                    const sc_core::sc_actions& actions) {
+    handle_report(rep, actions);
 }
+
+/* gives access to the action lookup of the sc_report_handler so that info
+ * messages can be handled without creating an sc_report */
+class info_actions : public sc_core::sc_report_handler
+{
+public:
+    /* determines the actions of an info message of the given type as
+     * sc_report_handler::report does, including the counting and the limit
+     * set with stop_after(). Returns false without counting if the message
+     * needs to be reported by sc_report_handler::report, i.e. if another
+     * handler is installed or an action requires an sc_report */
+    static auto execute(const char* msg_type, sc_core::sc_actions& actions)
+        -> bool {
+        // the actions handle_report() can execute for a direct_report
+        constexpr sc_core::sc_actions handled =
+            sc_core::SC_DO_NOTHING | sc_core::SC_LOG | sc_core::SC_DISPLAY |
+            sc_core::SC_STOP | sc_core::SC_ABORT;
+        if (handler != report_handler)
+            return false;
+        auto md = mdlookup(msg_type);
+        sc_core::sc_actions a = sc_core::SC_UNSPECIFIED;
+        if (md)
+            a = md->sev_actions[sc_core::SC_INFO];
+        if (md && a == sc_core::SC_UNSPECIFIED)
+            a = md->actions;
+        if (a == sc_core::SC_UNSPECIFIED)
+            a = sev_actions[sc_core::SC_INFO];
+        if (((a & ~suppress_mask) | force_mask) & ~handled)
+            return false;
+        actions = sc_report_handler::execute(
+            md ? md : add_msg_type(msg_type), sc_core::SC_INFO);
+        return true;
+    }
+};
+
 } // namespace
 
 static const std::array<sc_core::sc_severity, 8> severity = {
@@ -366,10 +2189,97 @@ static const std::array<sc_core::sc_verbosity, 8> verbosity = {
     sc_core::SC_FULL,   // scp::log::TRACE
     sc_core::SC_DEBUG   // scp::log::TRACEALL
 };
+/* the level the loggers write up to, the flight recorder may dump more than
+ * the logging level */
+static auto reported_level() -> scp::log {
+    return log_cfg.flight_recorder_size
+               ? std::max(log_cfg.level, log_cfg.flight_recorder_level)
+               : log_cfg.level;
+}
 static std::mutex cfg_guard;
+// reset by shutdown_logging() so that logging can be initialized again
+static bool spdlog_initialized = false;
+/* creates a logger with the output mode and overflow policy of log_cfg */
+template <typename SINK, typename... ARGS>
+static auto create_logger(const std::string& name, ARGS&&... args)
+    -> std::shared_ptr<spdlog::logger> {
+    if (!log_cfg.log_async)
+        return spdlog::synchronous_factory::create<SINK>(
+            name, std::forward<ARGS>(args)...);
+    if (log_cfg.async_overflow_policy == scp::async_overflow::OVERRUN_OLDEST)
+        return spdlog::async_factory_nonblock::create<SINK>(
+            name, std::forward<ARGS>(args)...);
+    return spdlog::async_factory::create<SINK>(name,
+                                               std::forward<ARGS>(args)...);
+}
+static auto create_console_logger(const std::string& name,
+                                  const scp::LogConfig& cfg)
+    -> std::shared_ptr<spdlog::logger> {
+    auto logger = create_logger<spdlog::sinks::stdout_color_sink_mt>(name);
+    auto logger_fmt = cfg.print_severity ? "[%L] %v" : "%v";
+    if (cfg.output_format != scp::log_format::TEXT) {
+        set_pattern(*logger, "%v", cfg);
+        if (cfg.output_format == scp::log_format::CSV)
+            std::fputs(csv_header, stdout);
+    } else if (cfg.colored_output) {
+        std::ostringstream os;
+        os << "%^" << logger_fmt << "%$";
+        set_pattern(*logger, os.str(), cfg);
+    } else
+        set_pattern(*logger, "[%L] %v", cfg);
+    logger->set_level(spdlog::level::level_enum::trace);
+    return logger;
+}
+static auto create_file_logger(const std::string& name,
+                               const scp::LogConfig& cfg)
+    -> std::shared_ptr<spdlog::logger> {
+    {
+        std::ofstream ofs;
+        ofs.open(cfg.log_file_name, std::ios::out | std::ios::trunc);
+        if (cfg.output_format == scp::log_format::CSV)
+            ofs << csv_header;
+    }
+    auto logger = cfg.log_file_segment_size
+                      ? create_logger<mapped_file_sink>(name, cfg)
+                      : create_logger<spdlog::sinks::basic_file_sink_mt>(
+                            name, cfg.log_file_name);
+    set_pattern(*logger,
+                cfg.print_severity && cfg.output_format == scp::log_format::TEXT
+                    ? "[%8l] %v"
+                    : "%v",
+                cfg);
+    logger->set_level(spdlog::level::level_enum::trace);
+    return logger;
+}
+/* the drain_sink of the logger, it is added if the logger has none */
+static auto get_drain(spdlog::logger& logger) -> std::shared_ptr<drain_sink> {
+    for (auto& sink : logger.sinks())
+        if (auto drain = std::dynamic_pointer_cast<drain_sink>(sink))
+            return drain;
+    auto drain = std::make_shared<drain_sink>();
+    logger.sinks().push_back(drain);
+    return drain;
+}
+/* the sinks used if none is configured: the console and, if a file name is
+ * given, the file which takes the messages below INFO from the console */
+static auto default_sinks(const scp::LogConfig& cfg)
+    -> std::vector<scp::LogSink> {
+    std::vector<scp::LogSink> sinks;
+    sinks.push_back(
+        scp::LogSink()
+            .logLevel(cfg.log_file_name.size() ? scp::log::INFO
+                                               : scp::log::TRACEALL)
+            .logFilterRegex(cfg.log_filter_regex)
+            .logFormat(cfg.output_format));
+    if (cfg.log_file_name.size())
+        sinks.push_back(scp::LogSink()
+                            .fileName(cfg.log_file_name)
+                            .logFilterRegex(cfg.log_filter_regex)
+                            .logFormat(cfg.output_format));
+    return sinks;
+}
 static void configure_logging() {
     std::lock_guard<std::mutex> lock(cfg_guard);
-    static bool spdlog_initialized = false;
 
     sc_core::sc_report_handler::set_actions(
         sc_core::SC_ERROR,
@@ -379,64 +2289,54 @@ static void configure_logging() {
     sc_core::sc_report_handler::set_verbosity_level(
         verbosity[static_cast<unsigned>(log_cfg.level)]);
     sc_core::sc_report_handler::set_handler(report_handler);
-    if (!spdlog_initialized) {
-        spdlog::init_thread_pool(
-            1024U,
-            log_cfg.log_file_name.size()
-                ? 2U
-                : 1U); // queue with 8k items and 1 backing thread.
-        log_cfg.console_logger = log_cfg.log_async
-                                     ? spdlog::stdout_color_mt<
-                                           spdlog::async_factory>(
-                                           "console_logger")
-                                     : spdlog::stdout_color_mt(
-                                           "console_logger");
-        auto logger_fmt = log_cfg.print_severity ? "[%L] %v" : "%v";
-        if (log_cfg.colored_output) {
-            std::ostringstream os;
-            os << "%^" << logger_fmt << "%$";
-            log_cfg.console_logger->set_pattern(os.str());
-        } else
-            log_cfg.console_logger->set_pattern("[%L] %v");
-        log_cfg.console_logger->flush_on(spdlog::level::warn);
-        log_cfg.console_logger->set_level(spdlog::level::level_enum::trace);
-        if (log_cfg.log_file_name.size()) {
-            {
-                std::ofstream ofs;
-                ofs.open(log_cfg.log_file_name,
-                         std::ios::out | std::ios::trunc);
-            }
-            log_cfg.file_logger = log_cfg.log_async
-                                      ? spdlog::basic_logger_mt<
-                                            spdlog::async_factory>(
-                                            "file_logger",
-                                            log_cfg.log_file_name)
-                                      : spdlog::basic_logger_mt(
-                                            "file_logger",
-                                            log_cfg.log_file_name);
-            if (log_cfg.print_severity)
-                log_cfg.file_logger->set_pattern("[%8l] %v");
-            else
-                log_cfg.file_logger->set_pattern("%v");
-            log_cfg.file_logger->flush_on(spdlog::level::warn);
-            log_cfg.file_logger->set_level(spdlog::level::level_enum::trace);
-        }
-        spdlog_initialized = true;
-    } else {
-        log_cfg.console_logger = spdlog::get("console_logger");
-        if (log_cfg.log_file_name.size())
-            log_cfg.file_logger = spdlog::get("file_logger");
-    }
-    if (log_cfg.log_filter_regex.size()) {
-        log_cfg.reg_ex = std::regex(log_cfg.log_filter_regex,
-                                    std::regex::extended | std::regex::icase);
+    recorder.resize(log_cfg.flight_recorder_size);
+    // set before the invalidation as the cached levels include it
+    scp::flight_recorder_verbosity.store(
+        log_cfg.flight_recorder_size
+            ? verbosity[static_cast<unsigned>(log_cfg.flight_recorder_level)]
+            : 0,
+        std::memory_order_relaxed);
+    invalidate_log_verbosity();
+    auto sinks = log_cfg.sinks.size() ? log_cfg.sinks : default_sinks(log_cfg);
+    if (!spdlog_initialized && log_cfg.log_async)
+        spdlog::init_thread_pool(log_cfg.async_queue_size,
+                                 std::max(log_cfg.async_thread_count, 1U));
+    log_cfg.limiter.clear();
+    // the loggers are kept if the logging is configured again
+    log_cfg.outputs.clear();
+    log_cfg.outputs.reserve(sinks.size());
+    unsigned consoles = 0, files = 0;
+    for (const auto& sink : sinks) {
+        output out;
+        out.file = sink.file_name.size();
+        out.level = sink.level;
+        out.cfg = out.file ? file_config(log_cfg) : scp::LogConfig(log_cfg);
+        out.cfg.log_file_binary = out.file && out.cfg.log_file_binary;
+        out.cfg.log_file_name = sink.file_name;
+        out.cfg.log_filter_regex = sink.filter_regex;
+        out.cfg.output_format = sink.format;
+        out.cfg.sinks.clear();
+        if (out.cfg.log_filter_regex.size())
+            out.filter.set(out.cfg.log_filter_regex);
+        auto& count = out.file ? files : consoles;
+        auto name = std::string(out.file ? "file_logger" : "console_logger");
+        if (count++)
+            name += "." + std::to_string(count - 1);
+        if (spdlog_initialized)
+            out.logger = spdlog::get(name);
+        if (!out.logger)
+            out.logger = out.file ? create_file_logger(name, out.cfg)
+                                  : create_console_logger(name, out.cfg);
+        out.drain = get_drain(*out.logger);
+        log_cfg.outputs.push_back(std::move(out));
     }
+    spdlog_initialized = true;
 }
 
 void scp::reinit_logging(scp::log level) {
     sc_core::sc_report_handler::set_handler(report_handler);
     log_cfg.level = level;
-    lut.clear();
+    invalidate_log_verbosity();
 }
 
 void scp::init_logging(scp::log level, unsigned type_field_width,
@@ -454,11 +2354,90 @@ void scp::init_logging(const scp::LogConfig& log_config) {
 
 void scp::set_logging_level(scp::log level) {
     log_cfg.level = level;
+    invalidate_log_verbosity();
     sc_core::sc_report_handler::set_verbosity_level(
-        verbosity[static_cast<unsigned>(level)]);
-    log_cfg.console_logger->set_level(static_cast<spdlog::level::level_enum>(
-        SPDLOG_LEVEL_OFF -
-        std::min<int>(SPDLOG_LEVEL_OFF, static_cast<int>(log_cfg.level))));
+        verbosity[static_cast<unsigned>(log_cfg.level)]);
+    for (auto& out : log_cfg.outputs)
+        if (!out.file)
+            out.logger->set_level(static_cast<spdlog::level::level_enum>(
+                SPDLOG_LEVEL_OFF -
+                std::min<int>(SPDLOG_LEVEL_OFF,
+                              static_cast<int>(reported_level()))));
+}
+
+auto scp::record_only() -> bool {
+    if (!recorder.enabled())
+        return false;
+    record_only_pending = true;
+    return true;
+}
+
+auto scp::rate_limit_passed(sc_core::sc_severity severity,
+                            const char* msg_type, int verbosity,
+                            const char* file, int line) -> bool {
+    if (likely(!log_cfg.rate_limit) || severity > sc_core::SC_WARNING)
+        return true;
+    direct_report rep{ severity, msg_type, "", verbosity, file, line };
+    // messages which are dropped are not counted
+    if (severity == sc_core::SC_INFO &&
+        verbosity > sc_core::sc_report_handler::get_verbosity_level())
+        return true;
+    if (is_suppressed(rep)) {
+        count_filtered(rep);
+        return false;
+    }
+    rate_checked = true;
+    return true;
+}
+
+auto scp::report_direct(sc_core::sc_severity severity, const char* msg_type,
+                        const char* msg, int verbosity, const char* file,
+                        int line) -> bool {
+    direct_report rep{ severity, msg_type, msg, verbosity, file, line };
+    if (record_message(rep))
+        return true;
+    // mimic the verbosity check of sc_report_handler::report, which returns
+    // before the handler could reset recorded
+    if (severity == sc_core::SC_INFO &&
+        verbosity > sc_core::sc_report_handler::get_verbosity_level()) {
+        recorded = false;
+        return true;
+    }
+    // only SC_INFO is handled here, everything else may trigger actions
+    // which are determined by the sc_report_handler
+    if (!log_cfg.direct_output || severity != sc_core::SC_INFO ||
+        log_cfg.outputs.empty())
+        return false;
+    sc_core::sc_actions actions;
+    if (!info_actions::execute(msg_type, actions))
+        return false;
+    handle_report(rep, actions);
+    return true;
+}
+
+auto scp::register_deferred_format(scp::deferred_message::format_fn format)
+    -> uint32_t {
+    return get_deferred_formats().add(format);
+}
+
+auto scp::report_deferred(sc_core::sc_severity severity,
+                          const char* msg_type,
+                          const scp::deferred_message& msg, int verbosity,
+                          const char* file, int line) -> bool {
+    if (!log_cfg.deferred_formatting || severity != sc_core::SC_INFO ||
+        log_cfg.outputs.empty())
+        return false;
+    if (verbosity > sc_core::sc_report_handler::get_verbosity_level())
+        return true;
+    deferred_entry rep({ severity, msg_type, "", verbosity, file, line }, msg);
+    if (record_message(rep))
+        return true;
+    // a fallback to report_direct() does not record the message again
+    sc_core::sc_actions actions;
+    if (!info_actions::execute(msg_type, actions))
+        return false;
+    handle_report(rep, actions);
+    return true;
 }
 
 auto scp::get_logging_level() -> scp::log {
@@ -469,26 +2448,78 @@ void scp::set_cycle_base(sc_core::sc_time period) {
     log_cfg.cycle_base = period;
 }
 
-void scp::shutdown_logging() {
-    // Flush all loggers before shutdown
-    if (log_cfg.console_logger) {
-        log_cfg.console_logger->flush();
+void scp::flush_logging() {
+    drain_outputs();
+}
+
+void scp::dump_flight_recorder() {
+    dump_recorder();
+}
+
+auto scp::get_log_statistics() -> std::vector<scp::log_statistics> {
+    return stats.get_all();
+}
+
+void scp::reset_log_statistics() {
+    stats.clear();
+}
+
+auto scp::get_dropped_messages() -> size_t {
+    auto pool = spdlog::thread_pool();
+    return pool ? pool->overrun_counter() : 0;
+}
+
+auto scp::decode_log_file(std::istream& is, std::ostream& os) -> bool {
+    std::string data{ std::istreambuf_iterator<char>(is),
+                      std::istreambuf_iterator<char>() };
+    if (data.compare(0, sizeof(binary_file_magic), binary_file_magic,
+                     sizeof(binary_file_magic)) != 0) {
+        // a text segment, the unused rest is filled with zeros
+        os.write(data.data(), std::min(data.find('\0'), data.size()));
+        return true;
     }
-    if (log_cfg.file_logger) {
-        log_cfg.file_logger->flush();
+    binary_reader in{ data.data() + sizeof(binary_file_magic),
+                      data.data() + data.size() };
+    return decode_binary(in, os);
+}
+
+void scp::shutdown_logging() {
+    // Report discarded messages while the loggers are still available
+    if (!log_cfg.outputs.empty()) {
+        if (auto dropped = get_dropped_messages()) {
+            std::ostringstream os;
+            os << dropped
+               << " messages were discarded as the queue of the "
+                  "asynchronous output was full";
+            SC_REPORT_WARNING("scp.report", os.str().c_str());
+        }
     }
+    log_cfg.limiter.for_each([](rate_limiter::state& st) {
+        if (st.suppressed)
+            write_summary(st);
+    });
+    log_cfg.limiter.clear();
+    recorder.resize(0);
+    scp::flight_recorder_verbosity.store(0, std::memory_order_relaxed);
+    invalidate_log_verbosity();
+    if (log_cfg.collect_statistics && !stats.empty())
+        write_statistics();
+    stats.clear();
+    // Write all pending messages before shutdown
+    drain_outputs();
 
     // Clear our logger references before dropping them
     // This prevents use-after-free if logging is attempted after shutdown
     // (e.g., from static destructors)
-    log_cfg.console_logger.reset();
-    log_cfg.file_logger.reset();
+    log_cfg.outputs.clear();
 
     // Drop all spdlog loggers to release resources
     spdlog::drop_all();
 
     // Shutdown the thread pool - this will join all worker threads
     spdlog::shutdown();
+    std::lock_guard<std::mutex> lock(cfg_guard);
+    spdlog_initialized = false;
 }
 
 auto scp::LogConfig::logLevel(scp::log level) -> scp::LogConfig& {
@@ -531,6 +2562,55 @@ auto scp::LogConfig::logFileName(const std::string& name) -> scp::LogConfig& {
     return *this;
 }
 
+auto scp::LogConfig::logFileSegmentSize(size_t size) -> scp::LogConfig& {
+    this->log_file_segment_size = size;
+    return *this;
+}
+
+auto scp::LogConfig::logFileSegments(unsigned count) -> scp::LogConfig& {
+    this->log_file_segments = count;
+    return *this;
+}
+
+auto scp::LogConfig::logFileBinary(bool enable) -> scp::LogConfig& {
+    this->log_file_binary = enable;
+    return *this;
+}
+
+auto scp::LogConfig::logFormat(scp::log_format format) -> scp::LogConfig& {
+    this->output_format = format;
+    return *this;
+}
+
+auto scp::LogConfig::rateLimit(unsigned count, sc_core::sc_time window)
+    -> scp::LogConfig& {
+    this->rate_limit = count;
+    this->rate_limit_window = window;
+    return *this;
+}
+
+auto scp::LogConfig::rateLimitByType(bool v) -> scp::LogConfig& {
+    this->rate_limit_by_type = v;
+    return *this;
+}
+
+auto scp::LogConfig::flightRecorder(size_t entries, scp::log level)
+    -> scp::LogConfig& {
+    this->flight_recorder_size = entries;
+    this->flight_recorder_level = level;
+    return *this;
+}
+
+auto scp::LogConfig::collectStatistics(bool enable) -> scp::LogConfig& {
+    this->collect_statistics = enable;
+    return *this;
+}
+
+auto scp::LogConfig::addSink(const scp::LogSink& sink) -> scp::LogConfig& {
+    this->sinks.push_back(sink);
+    return *this;
+}
+
 auto scp::LogConfig::coloredOutput(bool enable) -> scp::LogConfig& {
     this->colored_output = enable;
     return *this;
@@ -552,6 +2632,22 @@ auto scp::LogConfig::logAsync(bool v) -> scp::LogConfig& {
     return *this;
 }
 
+auto scp::LogConfig::asyncQueueSize(size_t v) -> scp::LogConfig& {
+    this->async_queue_size = v;
+    return *this;
+}
+
+auto scp::LogConfig::asyncThreadCount(unsigned v) -> scp::LogConfig& {
+    this->async_thread_count = v;
+    return *this;
+}
+
+auto scp::LogConfig::asyncOverflowPolicy(scp::async_overflow v)
+    -> scp::LogConfig& {
+    this->async_overflow_policy = v;
+    return *this;
+}
+
 auto scp::LogConfig::reportOnlyFirstError(bool v) -> scp::LogConfig& {
     this->report_only_first_error = v;
     return *this;
@@ -562,6 +2658,41 @@ auto scp::LogConfig::fileInfoFrom(int v) -> scp::LogConfig& {
     return *this;
 }
 
+auto scp::LogConfig::directOutput(bool v) -> scp::LogConfig& {
+    this->direct_output = v;
+    return *this;
+}
+
+auto scp::LogConfig::deferredFormatting(bool v) -> scp::LogConfig& {
+    this->deferred_formatting = v;
+    return *this;
+}
+
+auto scp::LogConfig::resolveAtElaboration(bool v) -> scp::LogConfig& {
+    this->resolve_at_elaboration = v;
+    return *this;
+}
+
+auto scp::LogSink::fileName(const std::string& name) -> scp::LogSink& {
+    this->file_name = name;
+    return *this;
+}
+
+auto scp::LogSink::logLevel(scp::log level) -> scp::LogSink& {
+    this->level = level;
+    return *this;
+}
+
+auto scp::LogSink::logFilterRegex(const std::string& expr) -> scp::LogSink& {
+    this->filter_regex = expr;
+    return *this;
+}
+
+auto scp::LogSink::logFormat(scp::log_format format) -> scp::LogSink& {
+    this->format = format;
+    return *this;
+}
+
 std::vector<std::string> split(const std::string& s) {
     std::vector<std::string> result;
     std::istringstream iss(s);
@@ -582,28 +2713,66 @@ std::string join(std::vector<std::string> vec) {
         });
 }
 
+/* adds the log_level parameter names a logger uses without wildcards, which
+ * are reported by scp::get_logging_parameters() */
+void add_logging_parameters(const logging_request& r,
+                            std::set<std::string>& names) {
+    auto add = [&names](const std::string& s) {
+        names.insert(s + "." SCP_LOG_LEVEL_PARAM_NAME);
+    };
+    for (auto scn = split(r.scname); scn.size(); scn.pop_back()) {
+        auto scn_str = join(scn);
+        for (auto& ft : r.features)
+            for (auto ftn = split(ft); ftn.size(); ftn.pop_back())
+                add(scn_str + "." + join(ftn));
+        add(scn_str + "." + r.type_name);
+        add(scn_str);
+    }
+    for (auto& ft : r.features)
+        for (auto ftn = split(ft); ftn.size(); ftn.pop_back())
+            add(join(ftn));
+    add(r.type_name);
+}
+
 std::vector<std::string> scp::get_logging_parameters() {
+    std::lock_guard<std::mutex> lock(index_guard);
+    for (auto& r : logging_requests)
+        add_logging_parameters(r, logging_parameters);
+    logging_requests.clear();
     return std::vector<std::string>(logging_parameters.begin(),
                                     logging_parameters.end());
 }
 
+/* the verbosity set by the parameter or the preset name.log_level, param is
+ * false if the broker has no such parameter */
 sc_core::sc_verbosity cci_lookup(cci::cci_broker_handle broker,
-                                 std::string name) {
+                                 std::string name, bool param = true) {
     auto param_name = (name.empty()) ? SCP_LOG_LEVEL_PARAM_NAME
                                      : name + "." SCP_LOG_LEVEL_PARAM_NAME;
-    auto h = broker.get_param_handle(param_name);
-    if (h.is_valid()) {
-        return verbosity.at(std::min<unsigned>(h.get_cci_value().get_int(),
-                                               verbosity.size() - 1));
-    } else {
-        auto val = broker.get_preset_cci_value(param_name);
-
-        if (val.is_int()) {
-            broker.lock_preset_value(param_name);
-            return verbosity.at(
-                std::min<unsigned>(val.get_int(), verbosity.size() - 1));
+    if (param) {
+        auto h = broker.get_param_handle(param_name);
+        if (h.is_valid()) {
+            bool watch;
+            {
+                std::lock_guard<std::mutex> lock(index_guard);
+                watch = watched_parameters.insert(param_name).second;
+            }
+            if (watch)
+                h.register_post_write_callback(
+                    [](const cci::cci_param_write_event<>&) {
+                        invalidate_log_verbosity();
+                    });
+            return verbosity.at(std::min<unsigned>(
+                h.get_cci_value().get_int(), verbosity.size() - 1));
         }
     }
+    auto val = broker.get_preset_cci_value(param_name);
+
+    if (val.is_int()) {
+        broker.lock_preset_value(param_name);
+        return verbosity.at(
+            std::min<unsigned>(val.get_int(), verbosity.size() - 1));
+    }
     return sc_core::SC_UNSET;
 }
 
@@ -626,90 +2795,473 @@ std::string demangle(const char* name) {
 }
 #endif
 
-void insert(std::multimap<int, std::string, std::greater<int>>& map,
-            std::string s, bool interesting) {
-    int n = std::count(s.begin(), s.end(), '.');
-    map.insert(make_pair(n, s));
-
-    if (interesting) {
-        logging_parameters.insert(s + "." SCP_LOG_LEVEL_PARAM_NAME);
-    }
+#ifdef HAS_CCI
+namespace {
+/* splits a name at each dot, keeping empty segments, "" has no segment */
+auto split_name(const std::string& s) -> std::vector<std::string> {
+    std::vector<std::string> result;
+    if (s.empty())
+        return result;
+    size_t begin = 0;
+    for (auto end = s.find('.'); end != std::string::npos;
+         begin = end + 1, end = s.find('.', begin))
+        result.push_back(s.substr(begin, end - begin));
+    result.push_back(s.substr(begin));
+    return result;
 }
 
-sc_core::sc_verbosity scp::scp_logger_cache::get_log_verbosity_cached(
-    const char* scname, const char* tname = "") {
-    if (level != sc_core::SC_UNSET) {
-        return level;
-    }
+/* the names of the log_level parameters and presets of a broker without
+ * the log_level segment, as a trie of their segments */
+struct log_level_node {
+    std::unordered_map<std::string, std::unique_ptr<log_level_node>> children;
+    bool param{ false };
+    bool preset{ false };
 
-    if (!scname && features.size())
-        scname = features[0].c_str();
-    if (!scname)
-        scname = "";
+    auto child(const std::string& segment) const -> const log_level_node* {
+        auto it = children.find(segment);
+        return it != children.end() ? it->second.get() : nullptr;
+    }
+    auto found() const -> bool { return param || preset; }
+};
 
-    type = std::string(scname);
+struct log_level_index {
+    log_level_node root;
+    // the parameters existing when the index is created are added once,
+    // later ones by the create callback
+    std::once_flag params_added;
+    // the parameters created so far, presets may have been consumed by them
+    uint64_t params_created{ 0 };
+    // the number of unconsumed presets and created parameters when the
+    // presets have been added last
+    size_t presets{ std::numeric_limits<size_t>::max() };
+    uint64_t presets_params{ 0 };
+
+    void add(const std::string& name, bool param) {
+        static const std::string suffix = "." SCP_LOG_LEVEL_PARAM_NAME;
+        std::string base;
+        if (name.size() > suffix.size() &&
+            !name.compare(name.size() - suffix.size(), suffix.size(), suffix))
+            base = name.substr(0, name.size() - suffix.size());
+        else if (name != SCP_LOG_LEVEL_PARAM_NAME)
+            return;
+        auto node = &root;
+        for (auto& seg : split_name(base)) {
+            auto& c = node->children[seg];
+            if (!c)
+                c.reset(new log_level_node);
+            node = c.get();
+        }
+        (param ? node->param : node->preset) = true;
+    }
+};
 
-#ifdef HAS_CCI
-    try {
-        // we rely on there being a broker, allow this to throw if not
-        auto broker = sc_core::sc_get_current_object()
-                          ? cci::cci_get_broker()
-                          : cci::cci_get_global_broker(scp_global_originator);
+std::map<std::string, log_level_index> log_level_indices;
 
-        std::multimap<int, std::string, std::greater<int>> allfeatures;
+/* the index of the broker, the parameters are added on first use */
+auto get_log_level_index(cci::cci_broker_handle& broker)
+    -> log_level_index& {
+    log_level_index* index;
+    {
+        std::lock_guard<std::mutex> lock(index_guard);
+        index = &log_level_indices[broker.name()];
+    }
+    // the broker is called without holding index_guard as its callbacks may
+    // log themselves
+    std::call_once(index->params_added, [&broker, index]() {
+        broker.register_create_callback(
+            [index](const cci::cci_param_untyped_handle& h) {
+                std::lock_guard<std::mutex> lock(index_guard);
+                index->add(h.name(), true);
+                ++index->params_created;
+            });
+        auto handles = broker.get_param_handles();
+        std::lock_guard<std::mutex> lock(index_guard);
+        for (auto& h : handles)
+            index->add(h.name(), true);
+    });
+    return *index;
+}
 
-        /* initialize */
-        for (auto scn = split(scname); scn.size(); scn.pop_back()) {
-            for (int first = 0; first < scn.size(); first++) {
-                auto f = scn.begin() + first;
-                std::vector<std::string> p(f, scn.end());
-                auto scn_str = ((first > 0) ? "*." : "") + join(p);
+/* a name of the index matching a candidate name of a logger */
+struct log_level_match {
+    size_t dots;
+    // the position of the candidate in the search order, see
+    // find_log_level_names()
+    std::array<size_t, 6> order;
+    std::string name;
+    bool param;
+
+    auto operator<(const log_level_match& o) const -> bool {
+        return dots != o.dots ? dots > o.dots : order < o.order;
+    }
+};
 
-                for (auto ft : features) {
-                    for (auto ftn = split(ft); ftn.size(); ftn.pop_back()) {
-                        insert(allfeatures, scn_str + "." + join(ftn),
-                               first == 0);
-                    }
+/* the names of the index a logger may use, in the order they are tried.
+ *
+ * The candidate names are the hierarchical name, each of its prefixes and
+ * each of their suffixes preceded by "*", each followed by a prefix of a
+ * feature, the type name or nothing. Then the prefixes of the features
+ * alone and preceded by "*", the type name, "*" and "". The candidates with
+ * more dots come first, otherwise they keep this order. Instead of building
+ * all candidates the index is walked along them, so only the names which
+ * exist are looked at. */
+void find_log_level_names(const log_level_node& root,
+                          const std::vector<std::string>& scn,
+                          const std::vector<std::vector<std::string>>& fts,
+                          const std::string& type_name,
+                          std::vector<log_level_match>& matches) {
+    using segments = std::vector<std::string>;
+    // the name of the segments [begin, end) of scn preceded by "*" if star
+    // is set and followed by the segments [sbegin, send)
+    auto name = [&scn](bool star, size_t begin, size_t end,
+                       segments::const_iterator sbegin,
+                       segments::const_iterator send) {
+        segments segs;
+        if (star)
+            segs.emplace_back("*");
+        segs.insert(segs.end(), scn.begin() + begin, scn.begin() + end);
+        segs.insert(segs.end(), sbegin, send);
+        return join(segs);
+    };
+    auto walk = [](const log_level_node* n, const segments& segs) {
+        for (auto& seg : segs)
+            if (!n || !(n = n->child(seg)))
+                return n;
+        return n;
+    };
+    auto type = split_name(type_name);
+    // the type name following a dot, "" is a segment then
+    auto type_suffix = type.empty() ? segments(1) : type;
+    auto star = root.child("*");
+
+    // the candidates based on the segments [first, last] of scn
+    for (size_t first = 0; first < scn.size(); ++first) {
+        auto node = first ? star : &root;
+        for (size_t last = first; node && last < scn.size(); ++last) {
+            if (!(node = node->child(scn[last])))
+                break;
+            auto dots = last - first + (first ? 1 : 0);
+            auto pos = scn.size() - 1 - last;
+            for (size_t i = 0; i < fts.size(); ++i) {
+                auto n = node;
+                for (size_t k = 0; k < fts[i].size(); ++k) {
+                    if (!(n = n->child(fts[i][k])))
+                        break;
+                    if (n->found())
+                        matches.push_back(
+                            { dots + k + 1,
+                              { 0, pos, first, 0, i, fts[i].size() - 1 - k },
+                              name(first != 0, first, last + 1, fts[i].begin(),
+                                   fts[i].begin() + k + 1),
+                              n->param });
                 }
-                insert(allfeatures, scn_str + "." + demangle(tname),
-                       first == 0);
-                insert(allfeatures, scn_str, first == 0);
             }
+            auto n = walk(node, type_suffix);
+            if (n && n->found())
+                matches.push_back({ dots + type_suffix.size(),
+                                    { 0, pos, first, 1, 0, 0 },
+                                    name(first != 0, first, last + 1,
+                                         type_suffix.begin(),
+                                         type_suffix.end()),
+                                    n->param });
+            if (node->found())
+                matches.push_back({ dots,
+                                    { 0, pos, first, 2, 0, 0 },
+                                    name(first != 0, first, last + 1,
+                                         type.end(), type.end()),
+                                    node->param });
         }
-        for (auto ft : features) {
-            for (auto ftn = split(ft); ftn.size(); ftn.pop_back()) {
-                insert(allfeatures, join(ftn), true);
-                insert(allfeatures, "*." + join(ftn), false);
+    }
+    // the features alone and preceded by "*"
+    for (size_t i = 0; i < fts.size(); ++i) {
+        for (size_t wild = 0; wild < 2; ++wild) {
+            auto n = wild ? star : &root;
+            for (size_t k = 0; n && k < fts[i].size(); ++k) {
+                if (!(n = n->child(fts[i][k])))
+                    break;
+                if (n->found())
+                    matches.push_back(
+                        { k + wild,
+                          { 1, i, fts[i].size() - 1 - k, wild, 0, 0 },
+                          name(wild != 0, 0, 0, fts[i].begin(),
+                               fts[i].begin() + k + 1),
+                          n->param });
             }
         }
-        insert(allfeatures, demangle(tname), true);
-        insert(allfeatures, "*", false);
-        insert(allfeatures, "", false);
+    }
+    auto n = walk(&root, type);
+    if (n && n->found())
+        matches.push_back({ type.empty() ? 0 : type.size() - 1,
+                            { 2, 0, 0, 0, 0, 0 },
+                            type_name,
+                            n->param });
+    if (star && star->found())
+        matches.push_back({ 0, { 3, 0, 0, 0, 0, 0 }, "*", star->param });
+    if (root.found())
+        matches.push_back({ 0, { 4, 0, 0, 0, 0, 0 }, "", root.param });
+}
 
-        for (std::pair<int, std::string> f : allfeatures) {
-            sc_core::sc_verbosity v = cci_lookup(broker, f.second);
-            if (v != sc_core::SC_UNSET) {
-                level = v;
-                return v;
-            }
+/* the verbosity of a logger set by the log_level parameters and presets of
+ * the broker, SC_UNSET if there is none. Only the candidate names found in
+ * the index of the broker are queried. The presets are added to the index
+ * if the number of unconsumed presets or of parameters has changed, unless
+ * check_presets is false. */
+auto resolve_verbosity(cci::cci_broker_handle& broker, const char* scname,
+                       const std::vector<std::string>& features,
+                       const std::string& type_name, bool check_presets)
+    -> sc_core::sc_verbosity {
+    auto& index = get_log_level_index(broker);
+    std::vector<cci::cci_name_value_pair> presets;
+    if (check_presets)
+        presets = broker.get_unconsumed_preset_values();
+    auto scn = split(scname);
+    std::vector<std::vector<std::string>> fts;
+    for (auto& ft : features)
+        fts.push_back(split(ft));
+    std::vector<log_level_match> matches;
+    {
+        std::lock_guard<std::mutex> lock(index_guard);
+        if (check_presets && (presets.size() != index.presets ||
+                              index.params_created != index.presets_params)) {
+            for (auto& p : presets)
+                index.add(p.first, false);
+            index.presets = presets.size();
+            index.presets_params = index.params_created;
         }
+        find_log_level_names(index.root, scn, fts, type_name, matches);
+        logging_requests.insert({ scname, features, type_name });
+    }
+    std::sort(matches.begin(), matches.end());
+    for (auto& m : matches) {
+        auto v = cci_lookup(broker, m.name, m.param);
+        if (v != sc_core::SC_UNSET)
+            return v;
+    }
+    return sc_core::SC_UNSET;
+}
+} // namespace
+#endif
+
+namespace {
+/* returns the level of a logger, resolving it with resolve(scname) unless it
+ * has been resolved in the current epoch */
+template <typename RESOLVE>
+auto resolve_cache(scp::scp_logger_cache& cache, const char* scname,
+                   RESOLVE&& resolve) -> sc_core::sc_verbosity {
+    auto current = scp::log_level_epoch.load(std::memory_order_acquire);
+    if (cache.level != sc_core::SC_UNSET && cache.epoch == current) {
+        return cache.level;
+    }
+    // the epoch is taken before resolving so that a concurrent change
+    // forces another resolution
+    cache.epoch = current;
+
+    if (!scname && cache.features.size())
+        scname = cache.features[0].c_str();
+    if (!scname)
+        scname = "";
+
+    cache.type = std::string(scname);
+
+    auto v = sc_core::SC_UNSET;
+    try {
+        v = resolve(scname);
     } catch (const std::exception&) {
         // If there is no global broker, revert to initialized verbosity level
     }
+    if (v == sc_core::SC_UNSET)
+        v = static_cast<sc_core::sc_verbosity>(
+            ::sc_core::sc_report_handler::get_verbosity_level());
+    cache.gate = std::max(v, static_cast<sc_core::sc_verbosity>(
+                                 scp::flight_recorder_verbosity.load(
+                                     std::memory_order_relaxed)));
+    return cache.level = v;
+}
+} // namespace
 
+sc_core::sc_verbosity scp::scp_logger_cache::get_log_verbosity_cached(
+    const char* scname, const char* tname = "") {
+    return resolve_cache(*this, scname, [&](const char* name) {
+#ifdef HAS_CCI
+        // we rely on there being a broker, allow this to throw if not
+        auto broker = sc_core::sc_get_current_object()
+                          ? cci::cci_get_broker()
+                          : cci::cci_get_global_broker(scp_global_originator);
+        return resolve_verbosity(broker, name, features, demangle(tname),
+                                 true);
+#else
+        return sc_core::SC_UNSET;
 #endif
+    });
+}
 
-    return level = static_cast<sc_core::sc_verbosity>(
-               ::sc_core::sc_report_handler::get_verbosity_level());
+std::atomic<int> scp::flight_recorder_verbosity{ 0 };
+
+// starts at 1 so that a zero initialized verbosity_site is out of date
+std::atomic<uint32_t> scp::log_level_epoch{ 1 };
+
+auto scp::verbosity_site::resolve(char const* t) -> sc_core::sc_verbosity {
+    const char* owner = nullptr;
+    if (!name.compare_exchange_strong(owner, t, std::memory_order_relaxed) &&
+        owner != t)
+        return get_log_verbosity(t);
+    // read the epoch first so that a concurrent change forces another
+    // resolution
+    uint64_t epoch = log_level_epoch.load(std::memory_order_acquire);
+    auto v = get_log_verbosity(t);
+    // the levels are compared with the verbosity of the macros only, so
+    // they are clamped to 16 bits
+    auto clamp = [](int l) -> uint64_t {
+        return static_cast<uint64_t>(std::min(std::max(l, 0), 0xffff));
+    };
+    auto gate = std::max<int>(
+        v, flight_recorder_verbosity.load(std::memory_order_relaxed));
+    state.store(epoch << 32 | clamp(gate) << 16 | clamp(v),
+                std::memory_order_relaxed);
+    return v;
 }
 
 auto scp::get_log_verbosity(char const* str) -> sc_core::sc_verbosity {
     auto k = char_hash(str);
-    auto it = lut.find(k);
-    if (it != lut.end())
-        return it->second;
+    sc_core::sc_verbosity v;
+    if (verbosity_lut().find(k, v))
+        return v;
 
+    // resolve outside of the table lock, the CCI lookup may log itself
     scp::scp_logger_cache tmp;
-    lut[k] = tmp.get_log_verbosity_cached(str);
-    return lut[k];
+    v = tmp.get_log_verbosity_cached(str);
+    verbosity_lut().insert(k, v, tmp.epoch);
+    return v;
+}
+
+/* the work shared by the loggers resolved in one batch: the unconsumed
+ * presets of a broker are checked once, the type names are demangled once and
+ * loggers of the same owner with the same features are resolved once */
+class scp::logger_resolution
+{
+public:
+#ifdef HAS_CCI
+    //! the broker of the owner of the logger resolved next
+    cci::cci_broker_handle* broker = nullptr;
+#endif
+
+    auto resolve(const std::vector<std::string>& features, const char* scname,
+                 const char* tname) -> sc_core::sc_verbosity {
+#ifdef HAS_CCI
+        auto key = std::make_tuple(broker->name(), std::string(scname), tname,
+                                   features);
+        auto it = results.find(key);
+        if (it != results.end())
+            return it->second;
+        auto type = type_names.find(tname);
+        if (type == type_names.end())
+            type = type_names.emplace(tname, demangle(tname)).first;
+        auto check_presets = checked_brokers.insert(broker->name()).second;
+        auto v = resolve_verbosity(*broker, scname, features, type->second,
+                                   check_presets);
+        results.emplace(std::move(key), v);
+        return v;
+#else
+        return sc_core::SC_UNSET;
+#endif
+    }
+
+private:
+    std::unordered_map<const char*, std::string> type_names;
+    std::set<std::string> checked_brokers;
+    std::map<std::tuple<std::string, std::string, const char*,
+                        std::vector<std::string>>,
+             sc_core::sc_verbosity>
+        results;
+};
+
+namespace {
+/* a logger registered for the resolution at the end of elaboration */
+struct pending_logger {
+    const void* key;
+    std::function<void(scp::logger_resolution&)> resolve;
+#ifdef HAS_CCI
+    // the batch runs outside of the module hierarchy, hence the broker of
+    // the owner is taken when the logger is registered
+    cci::cci_broker_handle broker;
+#endif
+};
+
+/* the loggers registered for the resolution at the end of elaboration, in
+ * the order of their construction */
+struct logger_batch : public sc_core::sc_stage_callback_if {
+    std::vector<pending_logger> pending;
+    std::unordered_map<const void*, size_t> index;
+    bool registered{ false };
+
+    void stage_callback(const sc_core::sc_stage&) override { resolve(); }
+
+    void resolve() {
+        auto batch = std::move(pending);
+        pending.clear();
+        index.clear();
+        scp::logger_resolution resolution;
+        for (auto& p : batch) {
+            if (!p.resolve)
+                continue;
+#ifdef HAS_CCI
+            resolution.broker = &p.broker;
+#endif
+            p.resolve(resolution);
+        }
+    }
+};
+
+/* never destroyed as loggers may unregister during static destruction */
+auto get_logger_batch() -> logger_batch& {
+    static auto batch = new logger_batch;
+    return *batch;
 }
+} // namespace
+
+auto scp::batch_resolution_enabled() -> bool {
+    return log_cfg.resolve_at_elaboration &&
+           (sc_core::sc_get_status() & (sc_core::SC_ELABORATION |
+                                        sc_core::SC_BEFORE_END_OF_ELABORATION));
+}
+
+void scp::register_logger(
+    const void* key, std::function<void(scp::logger_resolution&)> resolve) {
+    auto& batch = get_logger_batch();
+    if (!batch.registered) {
+        sc_core::sc_register_stage_callback(
+            batch, sc_core::SC_POST_END_OF_ELABORATION);
+        batch.registered = true;
+    }
+    batch.index[key] = batch.pending.size();
+#ifdef HAS_CCI
+    batch.pending.push_back(
+        { key, std::move(resolve),
+          sc_core::sc_get_current_object()
+              ? cci::cci_get_broker()
+              : cci::cci_get_global_broker(scp_global_originator) });
+#else
+    batch.pending.push_back({ key, std::move(resolve) });
+#endif
+}
+
+void scp::unregister_logger(const void* key) {
+    auto& batch = get_logger_batch();
+    if (batch.index.empty())
+        return;
+    auto it = batch.index.find(key);
+    if (it != batch.index.end()) {
+        batch.pending[it->second].resolve = nullptr;
+        batch.index.erase(it);
+    }
+}
+
+void scp::resolve_logger(scp::logger_resolution& batch,
+                         scp::scp_logger_cache& cache, const char* scname,
+                         const char* tname) {
+    resolve_cache(cache, scname, [&](const char* name) {
+        return batch.resolve(cache.features, name, tname);
+    });
+}
+
+void scp::resolve_registered_loggers() { get_logger_batch().resolve(); }
@@ -0,0 +1,45 @@
+/*****************************************************************************
+  Licensed to Accellera Systems Initiative Inc. (Accellera) under one or
+  more contributor license agreements.  See the NOTICE file distributed
+  with this work for additional information regarding copyright ownership.
+  Accellera licenses this file to you under the Apache License, Version 2.0
+  (the "License"); you may not use this file except in compliance with the
+  License.  You may obtain a copy of the License at
+    http://www.apache.org/licenses/LICENSE-2.0
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or
+  implied.  See the License for the specific language governing
+  permissions and limitations under the License.
+ ****************************************************************************/
+
+/*
+ * Prints the segments of a log file written with
+ * scp::LogConfig::logFileSegmentSize() as text. The segments are given in
+ * the order they have been written, e.g.
+ *   scp_log_decode sim.log sim.log.1 sim.log.2
+ */
+
+#include <scp/report.h>
+
+#include <fstream>
+#include <iostream>
+
+int sc_main(int argc, char** argv) {
+    if (argc < 2) {
+        std::cerr << "usage: " << argv[0] << " <segment>...\n";
+        return 2;
+    }
+    int result = 0;
+    for (int i = 1; i < argc; ++i) {
+        std::ifstream is(argv[i], std::ios::binary);
+        if (!is) {
+            std::cerr << argv[i] << ": cannot open file\n";
+            result = 1;
+        } else if (!scp::decode_log_file(is, std::cout)) {
+            std::cerr << argv[i] << ": truncated or corrupt segment\n";
+            result = 1;
+        }
+    }
+    return result;
+}
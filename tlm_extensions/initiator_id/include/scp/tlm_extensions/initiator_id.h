@@ -47,7 +47,7 @@ public:
         *this = other;
     }
 
-    operator uint64_t() { return m_id; };
+    operator uint64_t() const { return m_id; };
 
 #define overload(_OP)                               \
     initiator_id& operator _OP(const uint64_t id) { \
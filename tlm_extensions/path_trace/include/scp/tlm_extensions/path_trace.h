@@ -16,66 +16,543 @@
 #ifndef _SCP_PATHTRACE_EXTENSION_H
 #define _SCP_PATHTRACE_EXTENSION_H
 
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <limits>
+#include <mutex>
 #include <sstream>
+#include <string>
 #include <systemc>
 #include <tlm>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
 
 namespace scp {
 namespace tlm_extensions {
 
 /**
- * @class Path recording TLM extension
+ * @class pooled_path
  *
- * @brief Path recording TLM extension
+ * @brief storage of the hops of a path trace extension
  *
- * @details Ignorable Extension type that can be used to trace
- *          transactions as they pass through a network.
+ * @details The first N hops are stored inside the extension, only longer
+ *          paths allocate. Extensions released with free() (e.g. by the
+ *          memory manager of the payload) are kept in a per thread pool and
+ *          reused by create() and clone(), so the steady state does not
+ *          allocate. The pool keeps at most max_pooled extensions, others
+ *          and those released after the pool of the thread has been
+ *          destroyed (e.g. from static destructors) are deleted.
  */
-
-class path_trace : public tlm::tlm_extension<path_trace>
+template <typename EXT, typename HOP, std::size_t N>
+class pooled_path : public tlm::tlm_extension<EXT>
 {
-    std::vector<sc_core::sc_object*> m_path;
+    HOP m_inline[N];
+    // holds all hops once there are more than N
+    std::vector<HOP> m_heap;
+    std::size_t m_size = 0;
+    EXT* m_next = nullptr;
+
+    // the released extensions of this thread
+    struct pool {
+        EXT* head = nullptr;
+        std::size_t size = 0;
+        ~pool() {
+            while (head) {
+                auto p = head;
+                head = p->m_next;
+                delete p;
+            }
+            destroyed() = true;
+        }
+    };
+    static pool& get_pool() {
+        static thread_local pool p;
+        return p;
+    }
+    // set when the pool of the thread is destroyed, it is trivially
+    // destructible so it can be read afterwards
+    static bool& destroyed() {
+        static thread_local bool d = false;
+        return d;
+    }
+
+protected:
+    void push(const HOP& hop) {
+        if (m_size < N) {
+            m_inline[m_size++] = hop;
+            return;
+        }
+        if (m_size == N)
+            m_heap.assign(m_inline, m_inline + N);
+        m_heap.push_back(hop);
+        ++m_size;
+    }
 
 public:
-    path_trace() = default;
-    path_trace(const path_trace&) = default;
+    //! the maximum number of released extensions kept per thread
+    static constexpr std::size_t max_pooled = 1024;
 
-    virtual tlm_extension_base* clone() const override {
-        return new path_trace(*this);
+    pooled_path() = default;
+    pooled_path(const pooled_path& other) { copy_path(other); }
+    pooled_path& operator=(const pooled_path& other) {
+        copy_path(other);
+        return *this;
     }
 
-    virtual void copy_from(const tlm_extension_base& ext) override {
-        const path_trace& other = static_cast<const path_trace&>(ext);
-        *this = other;
+    /**
+     * @brief get an extension from the pool, a new one if it is empty
+     * @return an empty extension, to be released with free()
+     */
+    static EXT* create() {
+        if (destroyed())
+            return new EXT;
+        auto& p = get_pool();
+        if (!p.head)
+            return new EXT;
+        auto ext = p.head;
+        p.head = ext->m_next;
+        ext->m_next = nullptr;
+        --p.size;
+        return ext;
+    }
+
+    virtual tlm::tlm_extension_base* clone() const override {
+        auto ext = create();
+        ext->copy_path(*this);
+        return ext;
+    }
+
+    virtual void copy_from(const tlm::tlm_extension_base& ext) override {
+        copy_path(static_cast<const EXT&>(ext));
     }
 
     /**
-     * @brief Stamp object into the PathTrace
-     * @param obj  Object to add to the PathTrace
+     * @brief Release the extension into the pool of the calling thread, or
+     * delete it if the pool is full or gone
      */
-    void stamp(sc_core::sc_object* obj) { m_path.push_back(obj); }
+    virtual void free() override {
+        if (destroyed() || get_pool().size >= max_pooled) {
+            delete this;
+            return;
+        }
+        reset();
+        auto& p = get_pool();
+        m_next = p.head;
+        p.head = static_cast<EXT*>(this);
+        ++p.size;
+    }
 
     /**
      * @brief Convenience function to clear vector (eg. before returning to a
      * pool)
      */
-    void reset() { m_path.clear(); }
+    void reset() {
+        m_size = 0;
+        m_heap.clear();
+    }
+
+    //! the number of hops
+    std::size_t size() const { return m_size; }
+    //! the hops in the order of stamping
+    const HOP* begin() const { return m_size > N ? m_heap.data() : m_inline; }
+    const HOP* end() const { return begin() + m_size; }
+
+private:
+    void copy_path(const pooled_path& other) {
+        if (&other == this)
+            return;
+        m_size = other.m_size;
+        if (m_size > N)
+            m_heap.assign(other.m_heap.begin(), other.m_heap.end());
+        else {
+            m_heap.clear();
+            std::copy(other.m_inline, other.m_inline + m_size, m_inline);
+        }
+    }
+};
+
+/**
+ * @class Path recording TLM extension
+ *
+ * @brief Path recording TLM extension
+ *
+ * @details Ignorable Extension type that can be used to trace
+ *          transactions as they pass through a network. The first N objects
+ *          are stored inside the extension (see pooled_path). A class
+ *          deriving from it passes itself as EXT, so it is its own extension
+ *          type and create() returns it.
+ */
+template <std::size_t N = 16, typename EXT = void>
+class basic_path_trace
+    : public pooled_path<typename std::conditional<std::is_void<EXT>::value,
+                                                   basic_path_trace<N, EXT>,
+                                                   EXT>::type,
+                         sc_core::sc_object*, N>
+{
+public:
+    /**
+     * @brief Stamp object into the PathTrace
+     * @param obj  Object to add to the PathTrace
+     */
+    void stamp(sc_core::sc_object* obj) { this->push(obj); }
+
     /**
      * @brief convert extension to a string
      * @param separator (default "->")
      * @return a string consisting of the names of each object stamped into the
      * path separated with the separator provided.
      */
-    std::string to_string(std::string separator = "->") {
-        std::stringstream info;
-        std::string s;
-        for (auto o : m_path) {
-            info << s << o->name();
-            s = separator;
+    std::string to_string(const std::string& separator = "->") const {
+        std::string info;
+        for (auto o : *this) {
+            if (!info.empty())
+                info += separator;
+            info += o->name();
+        }
+        return info;
+    }
+};
+
+/**
+ * @class path_trace
+ *
+ * @brief the path trace with the default inline capacity
+ */
+class path_trace : public basic_path_trace<16, path_trace>
+{
+};
+
+/**
+ * @class path_trace_names
+ *
+ * @brief table of the objects stamped into compact path traces
+ *
+ * @details Each object is interned once and gets a dense ID, starting at 0.
+ *          The names are looked up when a path is printed. As the objects
+ *          may be deleted at the end of the simulation, resolve() copies the
+ *          names of all interned objects, e.g. in end_of_simulation().
+ */
+class path_trace_names
+{
+    struct table {
+        std::mutex mtx;
+        std::unordered_map<const sc_core::sc_object*, uint32_t> ids;
+        std::vector<const sc_core::sc_object*> objects;
+        // a deque keeps the names in place when more are added
+        std::deque<std::string> names;
+    };
+    static table& get() {
+        static table t;
+        return t;
+    }
+
+public:
+    /**
+     * @brief get the ID of an object, it is assigned on the first call
+     * @param obj the object
+     * @return the ID
+     */
+    static uint32_t intern(const sc_core::sc_object* obj) {
+        auto& t = get();
+        std::lock_guard<std::mutex> lock(t.mtx);
+        auto it = t.ids.find(obj);
+        if (it != t.ids.end())
+            return it->second;
+        auto id = static_cast<uint32_t>(t.objects.size());
+        t.ids.emplace(obj, id);
+        t.objects.push_back(obj);
+        return id;
+    }
+
+    /**
+     * @brief get the name of an interned object
+     * @param id the ID
+     * @return the name, "?" for an unknown ID. A resolved name stays valid,
+     * otherwise the name of the object is returned.
+     */
+    static const char* name(uint32_t id) {
+        auto& t = get();
+        std::lock_guard<std::mutex> lock(t.mtx);
+        if (id < t.names.size())
+            return t.names[id].c_str();
+        return id < t.objects.size() ? t.objects[id]->name() : "?";
+    }
+
+    /**
+     * @brief copy the names of all interned objects, later lookups do not
+     * access the objects
+     */
+    static void resolve() {
+        auto& t = get();
+        std::lock_guard<std::mutex> lock(t.mtx);
+        for (auto i = t.names.size(); i < t.objects.size(); ++i)
+            t.names.emplace_back(t.objects[i]->name());
+    }
+
+    //! the number of interned objects
+    static std::size_t size() {
+        auto& t = get();
+        std::lock_guard<std::mutex> lock(t.mtx);
+        return t.objects.size();
+    }
+};
+
+/**
+ * @brief the time stamps of a hop, the simulation time and the host time
+ * (steady clock in ns) are only stored if enabled
+ */
+struct path_sim_time {
+    sc_core::sc_time::value_type ticks;
+    void set_sim_time() { ticks = sc_core::sc_time_stamp().value(); }
+    sc_core::sc_time time() const {
+        return sc_core::sc_time::from_value(ticks);
+    }
+};
+struct path_no_sim_time {
+    void set_sim_time() {}
+    sc_core::sc_time time() const { return sc_core::SC_ZERO_TIME; }
+};
+struct path_host_time {
+    uint64_t host_ns;
+    void set_host_time() {
+        host_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                      std::chrono::steady_clock::now().time_since_epoch())
+                      .count();
+    }
+    uint64_t host_time() const { return host_ns; }
+};
+struct path_no_host_time {
+    void set_host_time() {}
+    uint64_t host_time() const { return 0; }
+};
+
+/**
+ * @brief a hop of a compact_path_trace, with the simulation time of the
+ * stamp if TIMED is set and the host time if HOST_TIMED is set
+ */
+template <typename ID_T, bool TIMED, bool HOST_TIMED = false>
+struct path_hop
+    : std::conditional<TIMED, path_sim_time, path_no_sim_time>::type,
+      std::conditional<HOST_TIMED, path_host_time, path_no_host_time>::type {
+    ID_T id;
+};
+
+/**
+ * @class Compact path recording TLM extension
+ *
+ * @brief Path recording TLM extension storing the IDs of the objects
+ *
+ * @details Instead of the object pointers, the IDs assigned by
+ *          path_trace_names are stored (16 bit by default) and, if TIMED is
+ *          set, the simulation time of each stamp, if HOST_TIMED is set the
+ *          host time. The names are only looked up by to_string(). Models
+ *          should intern themselves once and stamp with the ID, stamping with
+ *          the object looks the ID up in the table.
+ */
+template <std::size_t N = 16, typename ID_T = uint16_t, bool TIMED = false,
+          bool HOST_TIMED = false>
+class compact_path_trace
+    : public pooled_path<compact_path_trace<N, ID_T, TIMED, HOST_TIMED>,
+                         path_hop<ID_T, TIMED, HOST_TIMED>, N>
+{
+public:
+    using hop = path_hop<ID_T, TIMED, HOST_TIMED>;
+
+    /**
+     * @brief Stamp an interned object into the path
+     * @param id the ID returned by path_trace_names::intern(), an ID which
+     * does not fit into ID_T is reported as an error and not stamped
+     */
+    void stamp_id(uint32_t id) {
+        if (id > std::numeric_limits<ID_T>::max()) {
+            SC_REPORT_ERROR("path_trace", "object ID exceeds the ID type");
+            return;
+        }
+        hop h;
+        h.id = static_cast<ID_T>(id);
+        h.set_sim_time();
+        h.set_host_time();
+        this->push(h);
+    }
+
+    /**
+     * @brief Stamp object into the path
+     * @param obj  Object to add to the path
+     */
+    void stamp(const sc_core::sc_object* obj) {
+        stamp_id(path_trace_names::intern(obj));
+    }
+
+    /**
+     * @brief convert extension to a string
+     * @param separator (default "->")
+     * @return the names of the stamped objects separated with the separator
+     */
+    std::string to_string(const std::string& separator = "->") const {
+        std::string info;
+        for (auto& h : *this) {
+            if (!info.empty())
+                info += separator;
+            info += path_trace_names::name(h.id);
         }
-        return info.str();
+        return info;
     }
 };
+/**
+ * @class route_statistics
+ *
+ * @brief latency statistics per hop pair of timed compact path traces
+ *
+ * @details record() adds the latency between each two consecutive hops of a
+ *          path to the histogram of the pair (from, to), for the simulation
+ *          time in ticks of the time resolution and, if the path has host
+ *          times, for the host time in ns. A histogram has a fixed size: the
+ *          count, minimum, maximum, sum and 64 power of two buckets, from
+ *          which the percentiles are estimated. The global() instance can be
+ *          fed by the models completing the transactions and printed by
+ *          to_string() at the end of the simulation.
+ */
+class route_statistics
+{
+public:
+    struct histogram {
+        uint64_t count = 0;
+        uint64_t min = std::numeric_limits<uint64_t>::max();
+        uint64_t max = 0;
+        uint64_t sum = 0;
+        //! bucket i counts the values with i significant bits
+        uint64_t buckets[65] = {};
+
+        void add(uint64_t val) {
+            ++count;
+            min = std::min(min, val);
+            max = std::max(max, val);
+            sum += val;
+            unsigned bits = 0;
+            for (auto v = val; v; v >>= 1)
+                ++bits;
+            ++buckets[bits];
+        }
+        double mean() const {
+            return count ? static_cast<double>(sum) / count : 0.0;
+        }
+        /**
+         * @brief estimate a percentile
+         * @param p the percentile, between 0 and 100
+         * @return the upper bound of the bucket holding it, limited to the
+         * range of the recorded values
+         */
+        uint64_t percentile(double p) const {
+            if (!count)
+                return 0;
+            auto rank = static_cast<uint64_t>(p / 100.0 * count + 0.5);
+            uint64_t seen = 0;
+            for (unsigned i = 0; i < 65; ++i) {
+                seen += buckets[i];
+                if (seen >= std::max<uint64_t>(rank, 1)) {
+                    auto bound = i ? (i < 64 ? (uint64_t(1) << i) - 1
+                                             : ~uint64_t(0))
+                                   : 0;
+                    return std::max(min, std::min(max, bound));
+                }
+            }
+            return max;
+        }
+    };
+
+    struct entry {
+        histogram sim;
+        histogram host;
+    };
+
+    //! the instance shared by all models
+    static route_statistics& global() {
+        static route_statistics stats;
+        return stats;
+    }
+
+    /**
+     * @brief add the latencies between the hops of a path
+     * @param path a compact_path_trace with TIMED or HOST_TIMED set
+     */
+    template <typename PATH>
+    void record(const PATH& path) {
+        if (path.size() < 2)
+            return;
+        std::lock_guard<std::mutex> lock(mtx);
+        auto prev = path.begin();
+        for (auto h = prev + 1; h != path.end(); prev = h++) {
+            auto& e = entries[key(prev->id, h->id)];
+            e.sim.add(h->time().value() - prev->time().value());
+            if (h->host_time())
+                e.host.add(h->host_time() - prev->host_time());
+        }
+    }
+
+    /**
+     * @brief get the statistics of a hop pair
+     * @return the statistics, nullptr if the pair has not been recorded
+     */
+    const entry* get(uint32_t from, uint32_t to) const {
+        std::lock_guard<std::mutex> lock(mtx);
+        auto it = entries.find(key(from, to));
+        return it == entries.end() ? nullptr : &it->second;
+    }
+
+    /**
+     * @brief call f(from, to, entry) for each recorded hop pair
+     */
+    template <typename F>
+    void for_each(F f) const {
+        std::lock_guard<std::mutex> lock(mtx);
+        for (auto& e : entries)
+            f(static_cast<uint32_t>(e.first >> 32),
+              static_cast<uint32_t>(e.first), e.second);
+    }
+
+    void clear() {
+        std::lock_guard<std::mutex> lock(mtx);
+        entries.clear();
+    }
+
+    /**
+     * @brief print the statistics, one line per hop pair with the names of
+     * path_trace_names
+     */
+    std::string to_string() const {
+        std::ostringstream os;
+        for_each([&os](uint32_t from, uint32_t to, const entry& e) {
+            auto t = [](uint64_t v) {
+                return sc_core::sc_time::from_value(v).to_string();
+            };
+            os << path_trace_names::name(from) << "->"
+               << path_trace_names::name(to) << ": count " << e.sim.count
+               << " min " << t(e.sim.min) << " mean "
+               << t(static_cast<uint64_t>(e.sim.mean())) << " p50 "
+               << t(e.sim.percentile(50)) << " p99 "
+               << t(e.sim.percentile(99)) << " max " << t(e.sim.max);
+            if (e.host.count)
+                os << " host min " << e.host.min << " ns mean "
+                   << static_cast<uint64_t>(e.host.mean()) << " ns p99 "
+                   << e.host.percentile(99) << " ns max " << e.host.max
+                   << " ns";
+            os << "\n";
+        });
+        return os.str();
+    }
+
+private:
+    static uint64_t key(uint32_t from, uint32_t to) {
+        return static_cast<uint64_t>(from) << 32 | to;
+    }
+
+    mutable std::mutex mtx;
+    std::unordered_map<uint64_t, entry> entries;
+};
 } // namespace tlm_extensions
 } // namespace scp
 #endif
@@ -18,6 +18,14 @@
 #include <systemc>
 #include <tlm>
 
+// released during static destruction, after the pool of the main thread has
+// been destroyed
+struct released_at_exit {
+    scp::tlm_extensions::path_trace* ext =
+        scp::tlm_extensions::path_trace::create();
+    ~released_at_exit() { ext->free(); }
+} released_at_exit_ext;
+
 SC_MODULE (test) {
     SC_CTOR (test) {
         scp::tlm_extensions::path_trace ext;
@@ -34,14 +42,89 @@ SC_MODULE (test) {
             SC_REPORT_INFO("ext test", "Success\n");
         } else {
             SC_REPORT_INFO("ext test", "Failour\n");
+            failed = true;
         }
         ext.reset();
+
+        // a path longer than the inline capacity
+        scp::tlm_extensions::basic_path_trace<2> small;
+        for (int i = 0; i < 5; ++i)
+            small.stamp(this);
+        auto copy = small;
+        if (copy.size() != 5 ||
+            copy.to_string(".") != "test.test.test.test.test")
+            failed = true;
+
+        // released extensions are reused
+        auto pooled = scp::tlm_extensions::path_trace::create();
+        pooled->stamp(this);
+        auto cloned = pooled->clone();
+        pooled->free();
+        if (scp::tlm_extensions::path_trace::create() != pooled)
+            failed = true;
+        if (static_cast<scp::tlm_extensions::path_trace*>(cloned)
+                ->to_string() != "test")
+            failed = true;
+        cloned->free();
+        pooled->free();
+
+        // compact path of interned IDs with the time of each hop
+        auto id = scp::tlm_extensions::path_trace_names::intern(this);
+        scp::tlm_extensions::compact_path_trace<4, uint16_t, true> compact;
+        compact.stamp_id(id);
+        compact.stamp(this);
+        if (compact.to_string() != "test->test" ||
+            compact.begin()->id != id ||
+            compact.begin()->time() != sc_core::SC_ZERO_TIME)
+            failed = true;
+
+        // latency statistics of the hop pairs
+        auto& routes = scp::tlm_extensions::route_statistics::global();
+        routes.record(compact);
+        auto pair = routes.get(id, id);
+        if (!pair || pair->sim.count != 1 || pair->sim.max != 0)
+            failed = true;
+
+        SC_THREAD(run);
     }
+
+    // the simulation and host time deltas of hops stamped while time passes
+    void run() {
+        using timed_trace =
+            scp::tlm_extensions::compact_path_trace<4, uint16_t, true, true>;
+        auto id = scp::tlm_extensions::path_trace_names::intern(this);
+        timed_trace path;
+        path.stamp_id(id);
+        wait(10, sc_core::SC_NS);
+        path.stamp_id(id);
+        wait(5, sc_core::SC_NS);
+        path.stamp_id(id);
+
+        auto h = path.begin();
+        if (path.size() != 3 ||
+            h[1].time() - h[0].time() != sc_core::sc_time(10, sc_core::SC_NS) ||
+            h[2].time() - h[1].time() != sc_core::sc_time(5, sc_core::SC_NS) ||
+            !h[0].host_time() || h[1].host_time() < h[0].host_time() ||
+            h[2].host_time() < h[1].host_time())
+            failed = true;
+
+        scp::tlm_extensions::route_statistics routes;
+        routes.record(path);
+        auto pair = routes.get(id, id);
+        if (!pair || pair->sim.count != 2 ||
+            pair->sim.min != sc_core::sc_time(5, sc_core::SC_NS).value() ||
+            pair->sim.max != sc_core::sc_time(10, sc_core::SC_NS).value() ||
+            pair->host.count != 2 ||
+            pair->host.sum != h[2].host_time() - h[0].host_time())
+            failed = true;
+    }
+
+    bool failed = false;
 };
 
 int sc_main(int argc, char** argv) {
     test test1("test");
 
     sc_core::sc_start();
-    return 0;
+    return test1.failed;
 }